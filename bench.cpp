@@ -0,0 +1,246 @@
+#include "graph.h"
+
+#include <chrono>
+#include <random>
+#include <streambuf>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Замеры операций графа на сгенерированных графах.
+// Каждое измерение — одна строка JSON в stdout, например
+// {"graph":"gnp","n":1024,"m":2048,"storage":"csr","op":"ADD_E","count":2048,
+//  "seconds":0.0001,"ns_per_op":48.8,"ops_per_sec":2.05e+07,"peak_rss_kb":4096}
+//
+// Каждая пара граф/хранилище запускается в отдельном дочернем процессе,
+// поэтому peak_rss_kb — пик памяти только этого запуска (до текущей операции).
+//
+// Флаги: --sizes=256,1024 (размеры G(n,p) и слоёных графов),
+//        --clique-sizes=8,10, --storage=matrix,bits,csr,
+//        --threads=N (для task()), --max-length=K (для G(n,p) и слоёных графов).
+
+using Clock = chrono::steady_clock;
+
+struct Workload {
+    string graph;
+    int n;
+    vector<pair<int, int>> edges;
+    int maxLength; // Ограничение длины циклов для task(), 0 — без ограничения
+};
+
+// Случайный ориентированный граф G(n, p) без петель
+Workload gnp(int n, double p, int maxLength, mt19937& rng) {
+    Workload w{"gnp", n, {}, maxLength};
+    bernoulli_distribution edge(p);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i != j && edge(rng)) w.edges.push_back({i, j});
+        }
+    }
+    return w;
+}
+
+// Полный ориентированный граф: число циклов растёт как (n - 1)!
+Workload clique(int n) {
+    Workload w{"clique", n, {}, 0};
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i != j) w.edges.push_back({i, j});
+        }
+    }
+    return w;
+}
+
+// Слои по width вершин, из каждой вершины два ребра в следующий слой,
+// и n / 16 обратных рёбер на несколько слоёв назад, замыкающих циклы
+Workload layered(int n, int width, int maxLength, mt19937& rng) {
+    Workload w{"layered", n, {}, maxLength};
+    int layers = (n + width - 1) / width;
+    auto at = [&](int layer, int k) { return min(n - 1, layer * width + k); };
+
+    uniform_int_distribution<int> pick(0, width - 1);
+    for (int v = 0; v + width < n; ++v) {
+        int next = v / width + 1;
+        w.edges.push_back({v, at(next, pick(rng))});
+        w.edges.push_back({v, at(next, pick(rng))});
+    }
+
+    uniform_int_distribution<int> layer(0, max(0, layers - 4));
+    for (int k = 0; k < max(1, n / 16); ++k) {
+        int to = layer(rng);
+        w.edges.push_back({at(to + 3, pick(rng)), at(to, pick(rng))});
+    }
+
+    sort(w.edges.begin(), w.edges.end());
+    w.edges.erase(unique(w.edges.begin(), w.edges.end()), w.edges.end());
+    return w;
+}
+
+// Пиковый размер резидентной памяти процесса на данный момент, КБ.
+// Процесс запуска начинается с копии родителя, где графы не строятся.
+long peakRssKb() {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+const char* storageName(Storage storage) {
+    switch (storage) {
+        case Storage::Bits: return "bits";
+        case Storage::Csr: return "csr";
+        default: return "matrix";
+    }
+}
+
+void report(const Workload& w, Storage storage, const string& op, long long count, double seconds) {
+    double ns = count > 0 ? seconds * 1e9 / count : 0;
+    double rate = seconds > 0 ? count / seconds : 0;
+    printf("{\"graph\":\"%s\",\"n\":%d,\"m\":%zu,\"storage\":\"%s\",\"op\":\"%s\","
+           "\"count\":%lld,\"seconds\":%.6f,\"ns_per_op\":%.2f,\"ops_per_sec\":%.4g,\"peak_rss_kb\":%ld}\n",
+           w.graph.c_str(), w.n, w.edges.size(), storageName(storage), op.c_str(),
+           count, seconds, ns, rate, peakRssKb());
+    fflush(stdout);
+}
+
+template <class F>
+double timeIt(F&& f) {
+    auto start = Clock::now();
+    f();
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Буфер, выбрасывающий всё, что в него пишут: вывод task() не должен
+// упираться в терминал
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+
+    streamsize xsputn(const char*, streamsize n) override {
+        return n;
+    }
+};
+
+void run(const Workload& w, Storage storage, int threads) {
+    vector<string> names(w.n);
+    for (int i = 0; i < w.n; ++i) names[i] = to_string(i);
+
+    Graph g(storage);
+
+    double t = timeIt([&] {
+        for (int i = 0; i < w.n; ++i) g.ADD_V(names[i]);
+    });
+    report(w, storage, "ADD_V", w.n, t);
+
+    t = timeIt([&] {
+        for (auto [s, e] : w.edges) g.ADD_E(names[s], names[e]);
+    });
+    report(w, storage, "ADD_E", w.edges.size(), t);
+
+    // Каждый шаг FIRST/NEXT — одна операция, включая завершающий -1
+    long long steps = 0;
+    volatile long long checksum = 0; // Не даёт компилятору выбросить обход
+    t = timeIt([&] {
+        for (int i = 0; i < w.n; ++i) {
+            for (int v = g.FIRST(names[i]); ; v = g.NEXT(names[i], v)) {
+                ++steps;
+                if (v == -1) break;
+                checksum += v;
+            }
+        }
+    });
+    report(w, storage, "FIRST_NEXT", steps, t);
+
+    // Число циклов считается заранее, чтобы выразить task() в нс на цикл
+    unsigned long long cycles = countCycles(g, threads, false, w.maxLength).total;
+    NullBuffer null;
+    streambuf* old = cout.rdbuf(&null);
+    t = timeIt([&] {
+        task(g, threads, w.maxLength);
+    });
+    cout.rdbuf(old);
+    report(w, storage, "task", cycles, t);
+
+    // Удаляется каждая десятая вершина, что не доводит граф до compact()
+    long long removed = 0;
+    t = timeIt([&] {
+        for (int i = 0; i < w.n; i += 10, ++removed) g.DEL_V(names[i]);
+    });
+    report(w, storage, "DEL_V", removed, t);
+}
+
+vector<int> parseList(const string& s) {
+    vector<int> values;
+    size_t start = 0;
+    while (start < s.size()) {
+        size_t end = s.find(',', start);
+        if (end == string::npos) end = s.size();
+        values.push_back(stoi(s.substr(start, end - start)));
+        start = end + 1;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    vector<int> sizes = {256, 1024, 4096};
+    vector<int> cliqueSizes = {8, 10};
+    vector<Storage> storages = {Storage::Matrix, Storage::Bits, Storage::Csr};
+    int threads = 1, maxLength = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--sizes=", 0) == 0) {
+            sizes = parseList(arg.substr(8));
+        } else if (arg.rfind("--clique-sizes=", 0) == 0) {
+            cliqueSizes = parseList(arg.substr(15));
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            storages.clear();
+            string list = arg.substr(10) + ",";
+            for (size_t p = 0, q; (q = list.find(',', p)) != string::npos; p = q + 1) {
+                string name = list.substr(p, q - p);
+                if (name == "matrix") storages.push_back(Storage::Matrix);
+                else if (name == "bits") storages.push_back(Storage::Bits);
+                else if (name == "csr") storages.push_back(Storage::Csr);
+                else throw std::invalid_argument("Unknown storage " + name);
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            threads = stoi(arg.substr(10));
+            if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+        } else if (arg.rfind("--max-length=", 0) == 0) {
+            maxLength = stoi(arg.substr(13));
+        } else {
+            throw std::invalid_argument("Unknown argument " + arg);
+        }
+    }
+
+    mt19937 rng(12345); // Фиксированное зерно: графы одинаковы от запуска к запуску
+    vector<Workload> workloads;
+    for (int n : sizes) workloads.push_back(gnp(n, 2.0 / n, maxLength, rng));
+    for (int n : cliqueSizes) workloads.push_back(clique(n));
+    for (int n : sizes) workloads.push_back(layered(n, 16, maxLength, rng));
+
+    for (const Workload& w : workloads) {
+        for (Storage storage : storages) {
+            pid_t pid = fork();
+            if (pid == -1) throw std::runtime_error("fork failed");
+            if (pid == 0) {
+                int code = 0;
+                try {
+                    run(w, storage, threads);
+                } catch (const std::exception& e) {
+                    fprintf(stderr, "%s\n", e.what());
+                    code = 1;
+                }
+                fflush(stdout);
+                _exit(code);
+            }
+
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                throw std::runtime_error("Benchmark " + w.graph + " " + storageName(storage) + " failed");
+            }
+        }
+    }
+    return 0;
+}
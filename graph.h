@@ -0,0 +1,2713 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <exception>
+#include <string_view>
+#include <charconv>
+#include <condition_variable>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+using namespace std;
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+
+private:
+    // Пустой файл не отображается; begin() тогда указывает на "", а не на
+    // nullptr, чтобы memchr(begin(), c, 0) и подобные вызовы были корректны
+    const char* data = "";
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+
+        struct stat st {};
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+
+        length = st.st_size;
+        if (length > 0) {
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            madvise(p, length, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (length > 0) munmap(const_cast<char*>(data), length);
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + length;
+    }
+};
+
+// Буферизованный вывод в поток out. Числа форматируются через to_chars прямо
+// в буфер, а в поток уходят куски примерно по chunk байт. С background = true
+// куски пишет отдельный поток, и вызывающий только отдаёт заполненный буфер
+// в очередь, получая взамен уже записанный пустой.
+class Writer {
+
+private:
+    static constexpr size_t MAX_QUEUED = 8; // Больше кусков в очереди — ждём записи
+
+    ostream& out;
+    size_t chunk;
+    string buffer;
+
+    bool background;
+    thread worker;
+    mutex lock;
+    condition_variable changed;
+    deque<string> queue;  // Куски, ждущие записи
+    vector<string> spare; // Записанные куски, их память используется повторно
+    bool writing = false;
+    bool closing = false;
+
+    void run() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [&] { return closing || !queue.empty(); });
+            if (queue.empty()) return;
+
+            string piece = std::move(queue.front());
+            queue.pop_front();
+            writing = true;
+            guard.unlock();
+
+            out.write(piece.data(), piece.size());
+            piece.clear();
+
+            guard.lock();
+            writing = false;
+            spare.push_back(std::move(piece));
+            changed.notify_all();
+        }
+    }
+
+    // Отдаёт заполненный буфер на запись
+    void ship() {
+        if (buffer.empty()) return;
+        if (!background) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+            return;
+        }
+
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] { return queue.size() < MAX_QUEUED; });
+        queue.push_back(std::move(buffer));
+        buffer.clear();
+        if (!spare.empty()) {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+        buffer.reserve(chunk);
+        changed.notify_all();
+    }
+
+public:
+    explicit Writer(ostream& out = cout, bool background = false, size_t chunk = 1 << 20)
+        : out(out), chunk(chunk), background(background) {
+        buffer.reserve(chunk);
+        if (background) worker = thread(&Writer::run, this);
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+        flush();
+        if (background) {
+            {
+                lock_guard<mutex> guard(lock);
+                closing = true;
+            }
+            changed.notify_all();
+            worker.join();
+        }
+    }
+
+    Writer& operator<<(string_view s) {
+        if (buffer.size() + s.size() > chunk) ship();
+        buffer.append(s);
+        return *this;
+    }
+
+    Writer& operator<<(char c) {
+        if (buffer.size() + 1 > chunk) ship();
+        buffer.push_back(c);
+        return *this;
+    }
+
+    template <class T, enable_if_t<is_integral_v<T> && !is_same_v<T, char>, int> = 0>
+    Writer& operator<<(T value) {
+        char digits[24];
+        auto [end, error] = to_chars(digits, digits + sizeof(digits), value);
+        return *this << string_view(digits, end - digits);
+    }
+
+    // Дожидается записи всего, что уже передано
+    void flush() {
+        ship();
+        if (background) {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&] { return queue.empty() && !writing; });
+        }
+        out.flush();
+    }
+};
+
+// Читает следующее целое число, пропуская пробелы и переводы строк.
+// Возвращает false, если чисел больше нет.
+inline bool nextInt(const char*& p, const char* end, long long& value) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+    if (p == end) return false;
+
+    bool negative = *p == '-';
+    if (negative) ++p;
+    if (p == end || *p < '0' || *p > '9') {
+        throw std::runtime_error("Unexpected character in input");
+    }
+
+    long long x = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        x = x * 10 + (*p - '0');
+        ++p;
+    }
+    value = negative ? -x : x;
+    return true;
+}
+
+// Форматы файлов со списком рёбер для Graph::importEdges
+enum class EdgeFormat {
+    EdgeList,    // Строки "src dst [weight]", комментарии начинаются с # или %
+    Dimacs,      // Строка "p <тип> n m", дуги "a u v w", рёбра "e u v" (в обе стороны)
+    MatrixMarket // "%%MatrixMarket matrix coordinate ...", элементы "i j [value]"
+};
+
+// Ребро из файла. У EdgeList концы — исходные идентификаторы вершин,
+// у остальных форматов и после перенумерации — индексы с нуля.
+struct EdgeRecord {
+    long long s;
+    long long e;
+    int w;
+};
+
+// Рёбра файла и число вершин. Если ids не пуст, вершина i называется ids[i],
+// иначе — своим номером в файле (i + 1).
+struct EdgeImport {
+    long long n = 0;
+    vector<EdgeRecord> edges;
+    vector<long long> ids;
+};
+
+inline int edgeWeight(long long w) {
+    if (w <= INT_MIN || w > INT_MAX) {
+        throw std::runtime_error("Weight out of range in input");
+    }
+    return w;
+}
+
+// Пропускает пробелы; true, если в строке больше ничего нет
+inline bool blankRest(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    return p == end;
+}
+
+// Читает следующее вещественное число строки (для Matrix Market с полем real)
+inline bool nextReal(const char*& p, const char* end, double& value) {
+    if (blankRest(p, end)) return false;
+    auto [next, error] = from_chars(p, end, value);
+    if (error != errc()) {
+        throw std::runtime_error("Unexpected character in input");
+    }
+    p = next;
+    return true;
+}
+
+// Делит [begin, end) на parts кусков, каждый из которых начинается с новой строки
+inline vector<const char*> splitLines(const char* begin, const char* end, int parts) {
+    vector<const char*> bounds = {begin};
+    for (int k = 1; k < parts; ++k) {
+        const char* p = max(bounds.back(), begin + (end - begin) * k / parts);
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        bounds.push_back(eol ? eol + 1 : end);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// Разбирает строки [begin, end) на threads потоках: parseLine(line, eol, edges)
+// добавляет рёбра одной строки. Куски склеиваются в порядке файла, так что
+// результат не зависит от числа потоков.
+template <class F>
+vector<EdgeRecord> parseChunks(const char* begin, const char* end, int threads, const F& parseLine) {
+    threads = max(threads, 1);
+    vector<const char*> bounds = splitLines(begin, end, threads);
+    vector<vector<EdgeRecord>> parts(threads);
+    vector<exception_ptr> errors(threads);
+
+    auto work = [&](int t) {
+        try {
+            for (const char* p = bounds[t]; p < bounds[t + 1]; ) {
+                const char* eol = static_cast<const char*>(memchr(p, '\n', bounds[t + 1] - p));
+                if (!eol) eol = bounds[t + 1];
+                parseLine(p, eol, parts[t]);
+                p = eol + 1;
+            }
+        } catch (...) {
+            errors[t] = current_exception();
+        }
+    };
+
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (auto& worker : pool) worker.join();
+    for (auto& error : errors) {
+        if (error) rethrow_exception(error);
+    }
+
+    if (threads == 1) return std::move(parts[0]);
+
+    size_t total = 0;
+    for (const auto& part : parts) total += part.size();
+    vector<EdgeRecord> edges;
+    edges.reserve(total);
+    for (auto& part : parts) {
+        edges.insert(edges.end(), part.begin(), part.end());
+        part = vector<EdgeRecord>();
+    }
+    return edges;
+}
+
+// Номера 64-битных идентификаторов в порядке первого появления.
+// Открытая адресация, таблица растёт вдвое при заполнении наполовину.
+class IdIndex {
+
+private:
+    vector<long long> keys;
+    vector<int> values; // -1 — свободный слот
+    vector<long long> order;
+
+    size_t slotOf(long long id) const {
+        uint64_t x = id; // splitmix64: идентификаторы часто идут с постоянным шагом
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return (x ^ (x >> 31)) & (keys.size() - 1);
+    }
+
+    void grow() {
+        size_t capacity = max<size_t>(1024, keys.size() * 2);
+        keys.assign(capacity, 0);
+        values.assign(capacity, -1);
+        for (int i = 0; i < (int)order.size(); ++i) {
+            size_t p = slotOf(order[i]);
+            while (values[p] != -1) p = (p + 1) & (capacity - 1);
+            keys[p] = order[i];
+            values[p] = i;
+        }
+    }
+
+public:
+    int add(long long id) {
+        if ((order.size() + 1) * 2 > keys.size()) grow();
+        size_t p = slotOf(id);
+        while (values[p] != -1) {
+            if (keys[p] == id) return values[p];
+            p = (p + 1) & (keys.size() - 1);
+        }
+        keys[p] = id;
+        values[p] = order.size();
+        order.push_back(id);
+        return values[p];
+    }
+
+    vector<long long> release() {
+        keys = vector<long long>();
+        values = vector<int>();
+        return std::move(order);
+    }
+};
+
+// Список рёбер "src dst [weight]" с произвольными 64-битными идентификаторами.
+// Вершины нумеруются в порядке первого появления в файле.
+inline EdgeImport readEdgeList(const char* begin, const char* end, int threads) {
+    EdgeImport result;
+    result.edges = parseChunks(begin, end, threads, [](const char* p, const char* eol, vector<EdgeRecord>& out) {
+        if (blankRest(p, eol) || *p == '#' || *p == '%') return;
+
+        long long s, e, w = 1;
+        if (!nextInt(p, eol, s) || !nextInt(p, eol, e)) {
+            throw std::runtime_error("Edge line needs two vertices");
+        }
+        nextInt(p, eol, w);
+        out.push_back({s, e, edgeWeight(w)});
+    });
+
+    IdIndex index;
+    for (auto& r : result.edges) {
+        r.s = index.add(r.s);
+        r.e = index.add(r.e);
+    }
+    result.ids = index.release();
+    result.n = result.ids.size();
+    return result;
+}
+
+// DIMACS: комментарии "c", строка задачи "p <тип> n m" и дуги "a u v w"
+// (формат кратчайших путей) или неориентированные рёбра "e u v".
+// Строки "n" (источник и сток в задачах о потоке) пропускаются.
+inline EdgeImport readDimacs(const char* begin, const char* end, int threads) {
+    EdgeImport result;
+    result.n = -1;
+    for (const char* p = begin; p < end && result.n < 0; ) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        if (!blankRest(p, eol) && *p == 'p') {
+            ++p;
+            blankRest(p, eol);
+            while (p < eol && *p != ' ' && *p != '\t') ++p; // Тип задачи
+            if (!nextInt(p, eol, result.n) || result.n < 0) {
+                throw std::runtime_error("Invalid DIMACS problem line");
+            }
+        }
+        p = eol + 1;
+    }
+    if (result.n < 0) {
+        throw std::runtime_error("DIMACS file has no problem line");
+    }
+
+    long long n = result.n;
+    result.edges = parseChunks(begin, end, threads, [n](const char* p, const char* eol, vector<EdgeRecord>& out) {
+        if (blankRest(p, eol)) return;
+        char kind = *p++;
+        if (kind == 'c' || kind == 'p' || kind == 'n') return;
+        if (kind != 'a' && kind != 'e') {
+            throw std::runtime_error("Unexpected DIMACS line");
+        }
+
+        long long u, v, w = 1;
+        if (!nextInt(p, eol, u) || !nextInt(p, eol, v)) {
+            throw std::runtime_error("DIMACS edge needs two vertices");
+        }
+        if (kind == 'a') nextInt(p, eol, w);
+        if (u < 1 || u > n || v < 1 || v > n) {
+            throw std::runtime_error("DIMACS vertex out of range");
+        }
+
+        out.push_back({u - 1, v - 1, edgeWeight(w)});
+        if (kind == 'e' && u != v) out.push_back({v - 1, u - 1, edgeWeight(w)});
+    });
+    return result;
+}
+
+// Matrix Market, только формат coordinate. Элемент (i, j) — ребро i -> j,
+// вершин max(rows, cols). Поле pattern даёт вес 1, real округляется до целого;
+// symmetric и hermitian добавляют ребро j -> i, skew-symmetric — с весом -w.
+inline EdgeImport readMatrixMarket(const char* begin, const char* end, int threads) {
+    const char* p = begin;
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!eol) eol = end;
+
+    string banner(p, eol);
+    transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c) { return tolower(c); });
+    istringstream words(banner);
+    string magic, object, layout, field, symmetry;
+    words >> magic >> object >> layout >> field >> symmetry;
+    if (magic != "%%matrixmarket" || object != "matrix") {
+        throw std::runtime_error("Not a Matrix Market file");
+    }
+    if (layout != "coordinate") {
+        throw std::runtime_error("Only coordinate Matrix Market files are supported");
+    }
+    if (field != "pattern" && field != "integer" && field != "real" && field != "double") {
+        throw std::runtime_error("Unsupported Matrix Market field " + field);
+    }
+    bool pattern = field == "pattern";
+    bool real = field == "real" || field == "double";
+    bool mirror = symmetry == "symmetric" || symmetry == "hermitian" || symmetry == "skew-symmetric";
+    bool skew = symmetry == "skew-symmetric";
+    if (!mirror && symmetry != "general") {
+        throw std::runtime_error("Unsupported Matrix Market symmetry " + symmetry);
+    }
+
+    // Строка размеров — первая после комментариев
+    long long rows = -1, cols = -1, entries;
+    for (p = eol + 1; p < end && rows < 0; p = eol + 1) {
+        eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        if (blankRest(p, eol) || *p == '%') continue;
+        if (!nextInt(p, eol, rows) || !nextInt(p, eol, cols) || !nextInt(p, eol, entries) || rows < 0 || cols < 0) {
+            throw std::runtime_error("Invalid Matrix Market size line");
+        }
+    }
+    if (rows < 0) {
+        throw std::runtime_error("Matrix Market file has no size line");
+    }
+
+    EdgeImport result;
+    result.n = max(rows, cols);
+    long long n = result.n;
+    const char* data = min(p, end);
+    result.edges = parseChunks(data, end, threads, [=](const char* p, const char* eol, vector<EdgeRecord>& out) {
+        if (blankRest(p, eol) || *p == '%') return;
+
+        long long i, j, w = 1;
+        if (!nextInt(p, eol, i) || !nextInt(p, eol, j)) {
+            throw std::runtime_error("Matrix Market entry needs row and column");
+        }
+        if (real) {
+            double x;
+            if (!nextReal(p, eol, x)) throw std::runtime_error("Matrix Market entry has no value");
+            w = llround(x);
+        } else if (!pattern && !nextInt(p, eol, w)) {
+            throw std::runtime_error("Matrix Market entry has no value");
+        }
+        if (i < 1 || i > n || j < 1 || j > n) {
+            throw std::runtime_error("Matrix Market index out of range");
+        }
+
+        out.push_back({i - 1, j - 1, edgeWeight(w)});
+        if (mirror && i != j) out.push_back({j - 1, i - 1, edgeWeight(skew ? -w : w)});
+    });
+    return result;
+}
+
+// Двоичный снимок графа. Файл начинается с заголовка SnapshotHeader, дальше
+// идут секции: длина в байтах (uint64) и сами данные, дополненные нулями
+// до кратного 8 размера. Так каждый массив в отображённом файле выровнен,
+// и при загрузке он копируется целиком, без разбора.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t storage;
+};
+
+constexpr char SNAPSHOT_MAGIC[8] = {'A', 'L', 'G', 'O', 'S', 'N', 'A', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 2; // 2: индекс имён не сохраняется
+
+class SnapshotWriter {
+
+private:
+    ofstream out;
+    string path;
+
+    void pad(uint64_t bytes) {
+        static const char zeros[8] = {};
+        out.write(zeros, (8 - bytes % 8) % 8);
+    }
+
+public:
+    explicit SnapshotWriter(const string& path) : out(path, ios::binary | ios::trunc), path(path) {
+        if (!out) {
+            throw std::runtime_error("Cannot create " + path);
+        }
+    }
+
+    void header(const SnapshotHeader& h) {
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+
+    template <class T>
+    void section(const T* data, size_t count) {
+        uint64_t bytes = count * sizeof(T);
+        out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+        out.write(reinterpret_cast<const char*>(data), bytes);
+        pad(bytes);
+    }
+
+    template <class T>
+    void section(const vector<T>& v) {
+        section(v.data(), v.size());
+    }
+
+    void section(const string& s) {
+        section(s.data(), s.size());
+    }
+
+    // Секция из rows строк по width элементов, лежащих в памяти с шагом stride
+    template <class T>
+    void rows(const T* data, size_t rows, size_t width, size_t stride) {
+        uint64_t bytes = rows * width * sizeof(T);
+        out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+        for (size_t i = 0; i < rows; ++i) {
+            out.write(reinterpret_cast<const char*>(data + i * stride), width * sizeof(T));
+        }
+        pad(bytes);
+    }
+
+    template <class T>
+    void value(T v) {
+        section(&v, 1);
+    }
+
+    void close() {
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write " + path);
+        }
+    }
+};
+
+class SnapshotReader {
+
+private:
+    const char* p;
+    const char* end;
+    string path;
+
+public:
+    void fail(const char* what) const {
+        throw std::runtime_error(string("Snapshot ") + path + ": " + what);
+    }
+
+    SnapshotReader(const MappedFile& file, const string& path)
+        : p(file.begin()), end(file.end()), path(path) {}
+
+    SnapshotHeader header() {
+        SnapshotHeader h;
+        if (end - p < (ptrdiff_t)sizeof(h)) fail("truncated header");
+        memcpy(&h, p, sizeof(h));
+        p += sizeof(h);
+
+        if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) fail("not a snapshot");
+        if (h.version != SNAPSHOT_VERSION) fail("unsupported version");
+        return h;
+    }
+
+    // Данные секции прямо в отображённом файле
+    template <class T>
+    pair<const T*, size_t> section() {
+        uint64_t bytes;
+        if (end - p < (ptrdiff_t)sizeof(bytes)) fail("truncated section");
+        memcpy(&bytes, p, sizeof(bytes));
+        p += sizeof(bytes);
+
+        uint64_t padded = bytes + (8 - bytes % 8) % 8;
+        if (bytes % sizeof(T) != 0 || padded > (uint64_t)(end - p)) fail("bad section size");
+        const T* data = reinterpret_cast<const T*>(p);
+        p += padded;
+        return {data, bytes / sizeof(T)};
+    }
+
+    template <class T>
+    void section(vector<T>& v) {
+        auto [data, count] = section<T>();
+        v.assign(data, data + count);
+    }
+
+    void section(string& s) {
+        auto [data, count] = section<char>();
+        s.assign(data, count);
+    }
+
+    template <class T>
+    T value() {
+        auto [data, count] = section<T>();
+        if (count != 1) fail("bad value");
+        return *data;
+    }
+
+    // Секция, в которой должно быть ровно count элементов
+    template <class T>
+    void section(vector<T>& v, size_t count) {
+        section(v);
+        if (v.size() != count) fail("unexpected section length");
+    }
+};
+
+// Способ хранения рёбер
+enum class Storage {
+    Matrix, // Матрица весов из int, отсутствие ребра — Graph::NO_EDGE
+    Bits,   // Матрица смежности, упакованная по 64 бита в слово
+    Csr     // Сжатые строки для разреженных графов
+};
+
+// Квадратная матрица int в одном буфере. Строки идут с шагом capacity,
+// и при нехватке места ёмкость удваивается, поэтому добавление вершины
+// не сдвигает уже записанные строки (кроме редких перестроек).
+// Новые и освободившиеся клетки заполняются значением empty.
+class DenseMatrix {
+
+private:
+    vector<int> cells;
+    int n = 0;
+    int cap = 0;
+    int empty;
+
+public:
+    explicit DenseMatrix(int empty = 0) : empty(empty) {}
+
+    int size() const {
+        return n;
+    }
+
+    int* operator[](int i) {
+        return cells.data() + (size_t)i * cap;
+    }
+
+    const int* operator[](int i) const {
+        return cells.data() + (size_t)i * cap;
+    }
+
+    void reserve(int count) {
+        if (count <= cap) return;
+
+        vector<int> wider((size_t)count * count, empty);
+        for (int i = 0; i < n; ++i) {
+            copy((*this)[i], (*this)[i] + n, wider.begin() + (size_t)i * count);
+        }
+        cells = std::move(wider);
+        cap = count;
+    }
+
+    // Пустая матрица count x count без запаса
+    void assign(int count) {
+        n = cap = count;
+        cells.assign((size_t)count * count, empty);
+    }
+
+    void add_vertex() {
+        if (n == cap) reserve(max(4, cap * 2));
+        ++n; // Новые строка и столбец уже заполнены значением empty
+    }
+
+    // Перенумерация за один проход: вершина i становится remap[i],
+    // вершины с remap[i] == -1 удаляются. remap возрастает на живых вершинах,
+    // поэтому строки и столбцы можно сдвигать на месте.
+    void compact(const vector<int>& remap) {
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (remap[i] == -1) continue;
+            const int* src = (*this)[i];
+            int* dst = (*this)[remap[i]];
+            for (int j = 0; j < n; ++j) {
+                if (remap[j] != -1) dst[remap[j]] = src[j];
+            }
+            count++;
+        }
+
+        // Освободившиеся строки и столбцы должны снова быть пустыми
+        for (int i = 0; i < n; ++i) {
+            int* r = (*this)[i];
+            fill(r + (i < count ? count : 0), r + n, empty);
+        }
+        n = count;
+    }
+
+    // В снимок попадают только n x n клеток, без запаса ёмкости
+    void save(SnapshotWriter& out) const {
+        out.value<int32_t>(n);
+        out.rows(cells.data(), n, n, cap);
+    }
+
+    void load(SnapshotReader& in) {
+        n = cap = in.value<int32_t>();
+        in.section(cells, (size_t)n * n);
+    }
+};
+
+// Матрица смежности, где строка хранится 64-битными словами.
+// Соседи ищутся по словам через count trailing zeros, так что
+// 64 отсутствующих ребра пропускаются за одну инструкцию.
+class BitMatrix {
+
+private:
+    vector<uint64_t> bits;
+    int n = 0;
+    int words = 0; // Слов на одну строку
+
+    uint64_t* row(int i) {
+        return bits.data() + (size_t)i * words;
+    }
+
+    const uint64_t* row(int i) const {
+        return bits.data() + (size_t)i * words;
+    }
+
+public:
+    int size() const {
+        return n;
+    }
+
+    bool get(int i, int j) const {
+        return (row(i)[j / 64] >> (j % 64)) & 1;
+    }
+
+    void set(int i, int j) {
+        row(i)[j / 64] |= 1ULL << (j % 64);
+    }
+
+    void reset(int i, int j) {
+        row(i)[j / 64] &= ~(1ULL << (j % 64));
+    }
+
+    // Пустая матрица n x n, память выделяется один раз
+    void assign(int count) {
+        n = count;
+        words = (n + 63) / 64;
+        bits.assign((size_t)n * words, 0);
+    }
+
+    void reserve(int count) {
+        int need = (count + 63) / 64;
+        if (need > words) {
+            // Строки стали шире: переносим их в новую раскладку
+            vector<uint64_t> wider((size_t)n * need, 0);
+            for (int i = 0; i < n; ++i) {
+                copy(row(i), row(i) + words, wider.begin() + (size_t)i * need);
+            }
+            bits = std::move(wider);
+            words = need;
+        }
+        bits.reserve((size_t)count * words);
+    }
+
+    void add_vertex() {
+        if ((n + 1 + 63) / 64 > words) reserve(max(n + 1, 2 * words * 64));
+        bits.resize((size_t)(n + 1) * words, 0);
+        ++n;
+    }
+
+    // Перенумерация: вершина i становится remap[i], remap[i] == -1 удаляется
+    void compact(const vector<int>& remap) {
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (remap[i] != -1) count++;
+        }
+
+        vector<uint64_t> packed((size_t)count * words, 0);
+        for (int i = 0; i < n; ++i) {
+            if (remap[i] == -1) continue;
+            uint64_t* dst = packed.data() + (size_t)remap[i] * words;
+            for (int j = next(i, 0); j != -1; j = next(i, j + 1)) {
+                if (remap[j] != -1) dst[remap[j] / 64] |= 1ULL << (remap[j] % 64);
+            }
+        }
+        bits = std::move(packed);
+        n = count;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.value<int32_t>(n);
+        out.rows(bits.data(), n, (n + 63) / 64, words);
+    }
+
+    void load(SnapshotReader& in) {
+        n = in.value<int32_t>();
+        if (n < 0) in.fail("bad bit rows");
+        words = (n + 63) / 64;
+        in.section(bits, (size_t)n * words);
+
+        // Биты за n-м столбцом должны быть нулями, иначе next() вернёт
+        // несуществующую вершину
+        if (n % 64 != 0) {
+            uint64_t padding = ~0ULL << (n % 64);
+            for (int i = 0; i < n; ++i) {
+                if (row(i)[words - 1] & padding) in.fail("bad bit rows");
+            }
+        }
+    }
+
+    // Первый сосед вершины i с номером >= from, либо -1
+    int next(int i, int from) const {
+        if (from >= n) return -1;
+        const uint64_t* r = row(i);
+        int w = from / 64;
+        uint64_t word = r[w] & (~0ULL << (from % 64));
+        while (word == 0) {
+            if (++w == words) return -1;
+            word = r[w];
+        }
+        return w * 64 + __builtin_ctzll(word);
+    }
+};
+
+// Сжатое построчное хранение (CSR): смещения строк, номера столбцов
+// и параллельный массив весов. Память растёт с числом рёбер, а не V^2.
+// Столбцы внутри строки отсортированы.
+class CsrStore {
+
+private:
+    vector<int> offsets = {0}; // Строка i занимает [offsets[i], offsets[i + 1])
+    vector<int> columns;
+    vector<int> weights;
+
+public:
+    // Позиция столбца j в строке i (или место для его вставки)
+    int find(int i, int j) const {
+        auto first = columns.begin() + offsets[i];
+        auto last = columns.begin() + offsets[i + 1];
+        return lower_bound(first, last, j) - columns.begin();
+    }
+
+    // Конец строки i: её рёбра занимают позиции [find(i, 0), rowEnd(i))
+    int rowEnd(int i) const {
+        return offsets[i + 1];
+    }
+
+    int column(int p) const {
+        return columns[p];
+    }
+
+    int size() const {
+        return offsets.size() - 1;
+    }
+
+    int edges() const {
+        return columns.size();
+    }
+
+    bool get(int i, int j) const {
+        int p = find(i, j);
+        return p < offsets[i + 1] && columns[p] == j;
+    }
+
+    int weight(int i, int j) const {
+        int p = find(i, j);
+        return p < offsets[i + 1] && columns[p] == j ? weights[p] : 0;
+    }
+
+    void set(int i, int j, int w) {
+        int p = find(i, j);
+        if (p < offsets[i + 1] && columns[p] == j) {
+            weights[p] = w;
+            return;
+        }
+        columns.insert(columns.begin() + p, j);
+        weights.insert(weights.begin() + p, w);
+        for (int k = i + 1; k < offsets.size(); ++k) offsets[k]++;
+    }
+
+    // Меняет вес только существующего ребра
+    void edit(int i, int j, int w) {
+        int p = find(i, j);
+        if (p < offsets[i + 1] && columns[p] == j) weights[p] = w;
+    }
+
+    void reset(int i, int j) {
+        int p = find(i, j);
+        if (p == offsets[i + 1] || columns[p] != j) return;
+        columns.erase(columns.begin() + p);
+        weights.erase(weights.begin() + p);
+        for (int k = i + 1; k < offsets.size(); ++k) offsets[k]--;
+    }
+
+    void reserve(int count) {
+        offsets.reserve(count + 1);
+    }
+
+    void add_vertex() {
+        offsets.push_back(offsets.back());
+    }
+
+    // Построение по строкам: clear(), затем для каждой строки
+    // push() её рёбер по возрастанию столбца и close_row()
+    void clear() {
+        offsets.assign(1, 0);
+        columns.clear();
+        weights.clear();
+    }
+
+    void push(int j, int w) {
+        columns.push_back(j);
+        weights.push_back(w);
+    }
+
+    void close_row() {
+        offsets.push_back(columns.size());
+    }
+
+    // Строит хранилище на n вершин из рёбер с концами в [0, n) двумя
+    // проходами сортировки подсчётом: по столбцу, затем устойчиво по строке.
+    // Из повторов одного ребра остаётся последнее.
+    void build(int n, const vector<EdgeRecord>& edges) {
+        if (edges.size() > INT_MAX) {
+            throw std::length_error("Too many edges for CsrStore");
+        }
+        int m = edges.size();
+
+        vector<int> start(n + 1, 0);
+        for (const auto& r : edges) start[r.e + 1]++;
+        for (int i = 0; i < n; ++i) start[i + 1] += start[i];
+        vector<int> byColumn(m);
+        for (int k = 0; k < m; ++k) byColumn[start[edges[k].e]++] = k;
+
+        start.assign(n + 1, 0);
+        for (const auto& r : edges) start[r.s + 1]++;
+        for (int i = 0; i < n; ++i) start[i + 1] += start[i];
+        vector<int> order(m);
+        for (int k : byColumn) order[start[edges[k].s]++] = k;
+        byColumn = vector<int>();
+
+        // Теперь start[i] — конец строки i в order
+        offsets.assign(1, 0);
+        columns.clear();
+        weights.clear();
+        columns.reserve(m);
+        weights.reserve(m);
+        for (int i = 0, p = 0; i < n; ++i) {
+            int rowStart = columns.size();
+            for (; p < start[i]; ++p) {
+                const EdgeRecord& r = edges[order[p]];
+                if ((int)columns.size() > rowStart && columns.back() == r.e) {
+                    weights.back() = r.w;
+                } else {
+                    columns.push_back(r.e);
+                    weights.push_back(r.w);
+                }
+            }
+            offsets.push_back(columns.size());
+        }
+    }
+
+    // Сливает строки с изменениями, упорядоченными по (s, e) без повторов,
+    // за один проход. Изменение с весом removed удаляет ребро, остальные
+    // добавляют его или меняют вес.
+    void merge(const vector<EdgeRecord>& changes, int removed) {
+        vector<int> updated_offsets = {0};
+        vector<int> updated_columns, updated_weights;
+        updated_columns.reserve(columns.size() + changes.size());
+        updated_weights.reserve(columns.size() + changes.size());
+
+        size_t c = 0;
+        for (int i = 0; i < size(); ++i) {
+            int p = offsets[i];
+            while (p < offsets[i + 1] || (c < changes.size() && changes[c].s == i)) {
+                bool fromChanges = c < changes.size() && changes[c].s == i
+                                   && (p == offsets[i + 1] || changes[c].e <= columns[p]);
+                if (!fromChanges) {
+                    updated_columns.push_back(columns[p]);
+                    updated_weights.push_back(weights[p]);
+                    p++;
+                    continue;
+                }
+                if (p < offsets[i + 1] && columns[p] == changes[c].e) p++; // Старое ребро заменяется
+                if (changes[c].w != removed) {
+                    updated_columns.push_back(changes[c].e);
+                    updated_weights.push_back(changes[c].w);
+                }
+                c++;
+            }
+            updated_offsets.push_back(updated_columns.size());
+        }
+
+        offsets = std::move(updated_offsets);
+        columns = std::move(updated_columns);
+        weights = std::move(updated_weights);
+    }
+
+    // Перенумерация за один проход по массивам: вершина i становится
+    // remap[i], строки и столбцы с remap[i] == -1 удаляются
+    void compact(const vector<int>& remap) {
+        int n = size();
+        int out = 0;
+        vector<int> updated_offsets = {0};
+        for (int i = 0; i < n; ++i) {
+            if (remap[i] != -1) {
+                for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+                    if (remap[columns[p]] == -1) continue;
+                    columns[out] = remap[columns[p]];
+                    weights[out] = weights[p];
+                    out++;
+                }
+                updated_offsets.push_back(out);
+            }
+        }
+        columns.resize(out);
+        weights.resize(out);
+        offsets = std::move(updated_offsets);
+    }
+
+    // Первый сосед вершины i с номером >= from, либо -1
+    int next(int i, int from) const {
+        int p = find(i, from);
+        return p < offsets[i + 1] ? columns[p] : -1;
+    }
+
+    // i-й по счёту сосед вершины v, либо -1
+    int nth(int v, int i) const {
+        int p = offsets[v] + i;
+        return i >= 0 && p < offsets[v + 1] ? columns[p] : -1;
+    }
+
+    void save(SnapshotWriter& out) const {
+        out.section(offsets);
+        out.section(columns);
+        out.section(weights);
+    }
+
+    void load(SnapshotReader& in) {
+        in.section(offsets);
+        in.section(columns);
+        in.section(weights, columns.size());
+
+        // Проверка одним проходом, чтобы испорченный файл не дал выход за границы
+        if (offsets.empty() || offsets[0] != 0 || offsets.back() != edges()) {
+            in.fail("bad CSR offsets");
+        }
+        for (int i = 0; i < size(); ++i) {
+            if (offsets[i] > offsets[i + 1]) in.fail("bad CSR offsets");
+        }
+        for (int i = 0; i < size(); ++i) {
+            for (int p = offsets[i]; p < offsets[i + 1]; ++p) {
+                if (columns[p] < 0 || columns[p] >= size() || (p > offsets[i] && columns[p - 1] >= columns[p])) {
+                    in.fail("bad CSR columns");
+                }
+            }
+        }
+    }
+};
+
+// Таблица имён вершин. Все имена лежат подряд в одной строке arena,
+// имя i занимает [offsets[i], offsets[i + 1]). Поиск по имени — открытая
+// адресация по массиву slots с номерами имён, поэтому сверх самого имени
+// на вершину приходится 4 байта смещения и 8–16 байт хеш-таблицы.
+class SymbolTable {
+
+private:
+    static constexpr int EMPTY = -1;
+    static constexpr int ERASED = -2;
+
+    string arena;
+    vector<uint32_t> offsets = {0};
+    vector<int> slots; // Размер — степень двойки, занято не больше половины
+    int used = 0;      // Слоты, не равные EMPTY (вместе с ERASED)
+    vector<int> same;  // Следующий номер с тем же именем или -1; в slots только первый
+
+    size_t slotOf(string_view s) const {
+        return std::hash<string_view>{}(s) & (slots.size() - 1);
+    }
+
+    void place(int i) {
+        size_t p = slotOf(name(i));
+        while (slots[p] != EMPTY) p = (p + 1) & (slots.size() - 1);
+        slots[p] = i;
+        used++;
+    }
+
+    // Перестраивает slots под count имён, сохраняя только те, что сейчас находятся
+    void rehash(size_t count) {
+        vector<int> kept;
+        for (int i : slots) {
+            if (i >= 0) kept.push_back(i);
+        }
+
+        size_t capacity = 16;
+        while (capacity < count * 2) capacity *= 2;
+        slots.assign(capacity, EMPTY);
+        used = 0;
+        for (int i : kept) place(i);
+    }
+
+    // Позиция имени s в slots или -1
+    long long locate(string_view s) const {
+        if (slots.empty()) return -1;
+        size_t p = slotOf(s);
+        while (slots[p] != EMPTY) {
+            if (slots[p] >= 0 && name(slots[p]) == s) return p;
+            p = (p + 1) & (slots.size() - 1);
+        }
+        return -1;
+    }
+
+public:
+    int size() const {
+        return offsets.size() - 1;
+    }
+
+    string_view name(int i) const {
+        return string_view(arena).substr(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    // Номер имени s или -1
+    int find(string_view s) const {
+        long long p = locate(s);
+        return p == -1 ? -1 : slots[p];
+    }
+
+    // Добавляет имя под номером size(). Если такое имя уже есть,
+    // find() по-прежнему возвращает первое, а новое встаёт в очередь за ним.
+    int add(string_view s) {
+        int i = size();
+        arena.append(s);
+        offsets.push_back(arena.size());
+        same.push_back(-1);
+
+        int first = find(s);
+        if (first == -1) {
+            if ((size_t)(used + 1) * 2 > slots.size()) rehash(size());
+            place(i);
+        } else {
+            while (same[first] != -1) first = same[first];
+            same[first] = i;
+        }
+        return i;
+    }
+
+    // Убирает имя i из поиска; сами символы остаются в arena до compact().
+    // Если было несколько таких имён, find() вернёт следующее.
+    void erase(int i) {
+        long long p = locate(name(i));
+        if (p == -1) return;
+        if (slots[p] == i) {
+            slots[p] = same[i] == -1 ? ERASED : same[i];
+        } else {
+            int prev = slots[p];
+            while (same[prev] != -1 && same[prev] != i) prev = same[prev];
+            if (same[prev] == i) same[prev] = same[i];
+        }
+        same[i] = -1;
+    }
+
+    // Оставляет имена с remap[i] != -1 под новыми номерами remap[i]
+    void compact(const vector<int>& remap) {
+        string updated_arena;
+        vector<uint32_t> updated_offsets = {0};
+        for (int i = 0; i < size(); ++i) {
+            if (remap[i] == -1) continue;
+            updated_arena.append(name(i));
+            updated_offsets.push_back(updated_arena.size());
+        }
+        arena = std::move(updated_arena);
+        offsets = std::move(updated_offsets);
+        reindex(vector<char>(size(), 0));
+    }
+
+    void reserve(int count) {
+        offsets.reserve(count + 1);
+        same.reserve(count);
+        if ((size_t)count * 2 > slots.size()) rehash(count);
+    }
+
+    // Строит индекс заново по именам i с skip[i] == 0; из одинаковых
+    // имён находится первое, остальные стоят за ним по порядку номеров
+    void reindex(const vector<char>& skip) {
+        slots.clear();
+        used = 0;
+        rehash(size());
+        same.assign(size(), -1);
+        vector<int> last(size(), -1); // Последний номер в очереди первого имени
+        for (int i = 0; i < size(); ++i) {
+            if (skip[i]) continue;
+            int first = find(name(i));
+            if (first == -1) {
+                place(i);
+                last[i] = i;
+            } else {
+                same[last[first]] = i;
+                last[first] = i;
+            }
+        }
+    }
+
+    // Сохраняются только имена. Положение имени в slots зависит от
+    // std::hash, который у разных сборок может отличаться, поэтому
+    // после load() индекс строится заново через reindex().
+    void save(SnapshotWriter& out) const {
+        out.section(arena);
+        out.section(offsets);
+    }
+
+    void load(SnapshotReader& in) {
+        in.section(arena);
+        in.section(offsets);
+
+        if (offsets.empty() || offsets[0] != 0 || offsets.back() != arena.size()) {
+            in.fail("bad name offsets");
+        }
+        for (int i = 0; i < size(); ++i) {
+            if (offsets[i] > offsets[i + 1]) in.fail("bad name offsets");
+        }
+    }
+};
+
+class Graph {
+
+public:
+    // Значение клетки Storage::Matrix, означающее отсутствие ребра
+    static constexpr int NO_EDGE = INT_MIN;
+
+private:
+    Storage _storage;
+
+    // Storage::Matrix: наличие ребра и его вес хранятся в одной клетке
+    DenseMatrix matrix{NO_EDGE};
+
+    // Storage::Bits: веса хранятся только для рёбер с весом не 1
+    BitMatrix bits;
+    unordered_map<uint64_t, int> bit_weights;
+
+    // Storage::Csr
+    CsrStore csr;
+
+    static uint64_t edgeKey(int s, int e) {
+        return (uint64_t)s << 32 | (uint32_t)e;
+    }
+
+    int cell(int s, int e) const {
+        switch (_storage) {
+            case Storage::Bits: return bits.get(s, e);
+            case Storage::Csr: return csr.get(s, e);
+            default: return matrix[s][e] != NO_EDGE;
+        }
+    }
+
+    void check(int i, const char* where) const {
+        if (i < 0 || i >= size() || _deleted[i]) {
+            throw std::out_of_range(string("Invalid vertex index in ") + where);
+        }
+    }
+
+    // Атрибуты вершины i лежат в отдельных массивах под индексом i
+    SymbolTable _names; // Имя вершины i — _names.name(i)
+    vector<int> _marks;
+
+    // Удалённые вершины только помечаются, их индексы освобождаются в compact()
+    vector<char> _deleted;
+    int _dead = 0;
+
+    // Первый сосед v с номером >= from без учёта удалённых вершин
+    int rawNext(int v, int from) const {
+        switch (_storage) {
+            case Storage::Bits: return bits.next(v, from);
+            case Storage::Csr: return csr.next(v, from);
+            default: break;
+        }
+
+        const int* row = matrix[v];
+        for (int j = from; j < matrix.size(); ++j) {
+            if (row[j] != NO_EDGE) {
+                return j;
+            }
+        }
+        return -1;
+    }
+
+public:
+    // Итератор по живым соседям вершины (индексам). Для CSR хранит позицию
+    // в строке и идёт за O(1) на соседа, для остальных хранилищ ищет
+    // следующего соседа через nextNeighbor().
+    class NeighborIterator {
+
+    private:
+        friend class Graph;
+
+        const Graph* graph = nullptr;
+        int v = 0;
+        int w = -1; // Текущий сосед, -1 — соседи кончились
+        int pos = 0;
+
+    public:
+        int operator*() const {
+            return w;
+        }
+
+        NeighborIterator& operator++() {
+            graph->advance(*this);
+            return *this;
+        }
+
+        bool operator!=(const NeighborIterator& other) const {
+            return w != other.w;
+        }
+
+        bool done() const {
+            return w == -1;
+        }
+    };
+
+    class NeighborRange {
+
+    private:
+        NeighborIterator first;
+
+    public:
+        explicit NeighborRange(NeighborIterator first) : first(first) {}
+
+        NeighborIterator begin() const {
+            return first;
+        }
+
+        NeighborIterator end() const {
+            return {};
+        }
+    };
+
+    // Живые соседи вершины с индексом v, начиная с номера from:
+    // for (int w : g.neighbors(v)) { ... }
+    NeighborRange neighbors(int v, int from = 0) const {
+        check(v, "neighbors");
+        NeighborIterator it;
+        it.graph = this;
+        it.v = v;
+        if (_storage == Storage::Csr) {
+            it.pos = csr.find(v, from);
+            settle(it);
+        } else {
+            it.w = nextNeighbor(v, from);
+        }
+        return NeighborRange(it);
+    }
+
+private:
+    // CSR: сдвигает позицию итератора на первого живого соседа
+    void settle(NeighborIterator& it) const {
+        int end = csr.rowEnd(it.v);
+        while (it.pos < end && _deleted[csr.column(it.pos)]) it.pos++;
+        it.w = it.pos < end ? csr.column(it.pos) : -1;
+    }
+
+    void advance(NeighborIterator& it) const {
+        if (_storage == Storage::Csr) {
+            it.pos++;
+            settle(it);
+        } else {
+            it.w = nextNeighbor(it.v, it.w + 1);
+        }
+    }
+
+public:
+    explicit Graph(Storage storage = Storage::Matrix) : _storage(storage) {}
+
+    // Первый живой сосед вершины с индексом v, чей номер >= from, либо -1.
+    // В отличие от FIRST/NEXT работает с индексами и не ищет имя.
+    int nextNeighbor(int v, int from) const {
+        int w = rawNext(v, from);
+        while (w != -1 && _deleted[w]) w = rawNext(v, w + 1);
+        return w;
+    }
+
+    int indexOfName(string_view name) const {
+        return _names.find(name);
+    }
+
+    int indexOfName(char c) const {
+        return indexOfName(string_view(&c, 1));
+    }
+
+    // Имя действительно до следующего ADD_V или compact()
+    string_view nameOfIndex(int i) const {
+        check(i, "nameOfIndex");
+        return _names.name(i);
+    }
+
+    // Загрузка из файла формата matrix.txt: число вершин n, затем матрица n x n.
+    // Ненулевая клетка — ребро с этим весом. Вершины получают имена 'a', 'b', ...,
+    // а если их больше 26 — десятичные номера "0", "1", ...
+    // Файл отображается в память, хранилище выделяется сразу под n вершин.
+    static Graph load(const string& path, Storage storage = Storage::Matrix) {
+        MappedFile file(path);
+        const char* p = file.begin();
+        const char* end = file.end();
+
+        long long n;
+        if (!nextInt(p, end, n) || n < 0 || n > INT32_MAX) {
+            throw std::runtime_error("Invalid vertex count in " + path);
+        }
+
+        Graph g(storage);
+        g._names.reserve(n);
+        g._marks.assign(n, 0);
+        for (int i = 0; i < n; ++i) {
+            if (n <= 26) {
+                char name = 'a' + i;
+                g._names.add(string_view(&name, 1));
+            } else {
+                g._names.add(to_string(i));
+            }
+        }
+        g._deleted.assign(n, 0);
+
+        switch (storage) {
+            case Storage::Bits: g.bits.assign(n); break;
+            case Storage::Csr: g.csr.clear(); break;
+            default:
+                g.matrix.assign(n);
+        }
+
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                long long w;
+                if (!nextInt(p, end, w)) {
+                    throw std::runtime_error("Matrix in " + path + " is truncated");
+                }
+                if (w == 0) continue;
+                if (w <= NO_EDGE || w > INT_MAX) {
+                    throw std::runtime_error("Weight out of range in " + path);
+                }
+
+                switch (storage) {
+                    case Storage::Bits:
+                        g.bits.set(i, j);
+                        if (w != 1) g.bit_weights[edgeKey(i, j)] = w;
+                        break;
+                    case Storage::Csr:
+                        g.csr.push(j, w);
+                        break;
+                    default:
+                        g.matrix[i][j] = w;
+                }
+            }
+            if (storage == Storage::Csr) g.csr.close_row();
+        }
+        return g;
+    }
+
+    // Сохраняет граф в двоичный снимок (формат — у SnapshotHeader).
+    // Удалённые вершины сохраняются вместе с пометками.
+    void saveSnapshot(const string& path) const {
+        SnapshotWriter out(path);
+
+        SnapshotHeader header{};
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.storage = (uint32_t)_storage;
+        out.header(header);
+
+        _names.save(out);
+        out.section(_marks);
+        out.section(_deleted);
+
+        switch (_storage) {
+            case Storage::Bits: {
+                bits.save(out);
+                vector<uint64_t> keys;
+                vector<int> values;
+                for (const auto& [key, w] : bit_weights) {
+                    keys.push_back(key);
+                    values.push_back(w);
+                }
+                out.section(keys);
+                out.section(values);
+                break;
+            }
+            case Storage::Csr:
+                csr.save(out);
+                break;
+            default:
+                matrix.save(out);
+        }
+        out.close();
+    }
+
+    // Загружает снимок, записанный saveSnapshot(). Файл отображается в память,
+    // и массивы копируются из него целиком, без разбора текста.
+    static Graph loadSnapshot(const string& path) {
+        MappedFile file(path);
+        SnapshotReader in(file, path);
+        SnapshotHeader header = in.header();
+        if (header.storage > (uint32_t)Storage::Csr) in.fail("unknown storage");
+
+        Graph g((Storage)header.storage);
+        g._names.load(in);
+        int n = g._names.size();
+        in.section(g._marks, n);
+        in.section(g._deleted, n);
+        for (char d : g._deleted) {
+            if (d != 0 && d != 1) in.fail("bad deleted flags");
+        }
+        g._names.reindex(g._deleted);
+        g._dead = count(g._deleted.begin(), g._deleted.end(), 1);
+
+        switch (g._storage) {
+            case Storage::Bits: {
+                g.bits.load(in);
+                auto [keys, count] = in.section<uint64_t>();
+                vector<int> values;
+                in.section(values, count);
+                g.bit_weights.reserve(count);
+                for (size_t k = 0; k < count; ++k) {
+                    if ((keys[k] >> 32) >= (uint64_t)n || (uint32_t)keys[k] >= (uint64_t)n) in.fail("bad weight key");
+                    g.bit_weights.emplace(keys[k], values[k]);
+                }
+                break;
+            }
+            case Storage::Csr:
+                g.csr.load(in);
+                break;
+            default:
+                g.matrix.load(in);
+        }
+
+        if (g.size() != n) in.fail("adjacency does not match vertex count");
+        return g;
+    }
+
+    // Импорт из списка рёбер, DIMACS или Matrix Market (см. EdgeFormat).
+    // Строки разбираются на threads потоках, затем хранилище строится
+    // за один проход сортировки подсчётом. Вершины называются своими
+    // идентификаторами из файла; повторное ребро перезаписывает вес.
+    static Graph importEdges(const string& path, EdgeFormat format, Storage storage = Storage::Csr, int threads = 1) {
+        MappedFile file(path);
+        EdgeImport data;
+        switch (format) {
+            case EdgeFormat::Dimacs: data = readDimacs(file.begin(), file.end(), threads); break;
+            case EdgeFormat::MatrixMarket: data = readMatrixMarket(file.begin(), file.end(), threads); break;
+            default: data = readEdgeList(file.begin(), file.end(), threads);
+        }
+        if (data.n > INT32_MAX) {
+            throw std::runtime_error("Too many vertices in " + path);
+        }
+        int n = data.n;
+
+        Graph g(storage);
+        g._names.reserve(n);
+        for (int i = 0; i < n; ++i) {
+            g._names.add(to_string(data.ids.empty() ? i + 1 : data.ids[i]));
+        }
+        g._marks.assign(n, 0);
+        g._deleted.assign(n, 0);
+
+        if (storage == Storage::Csr) {
+            g.csr.build(n, data.edges);
+            return g;
+        }
+
+        CsrStore rows;
+        rows.build(n, data.edges);
+        data.edges = vector<EdgeRecord>();
+        if (storage == Storage::Bits) g.bits.assign(n);
+        else g.matrix.assign(n);
+
+        for (int i = 0; i < n; ++i) {
+            for (int p = rows.find(i, 0); p < rows.rowEnd(i); ++p) {
+                int j = rows.column(p), w = rows.weight(i, j);
+                if (storage == Storage::Bits) {
+                    g.bits.set(i, j);
+                    if (w != 1) g.bit_weights[edgeKey(i, j)] = w;
+                } else {
+                    g.matrix[i][j] = w;
+                }
+            }
+        }
+        return g;
+    }
+
+    // Начинается ли файл с заголовка снимка
+    static bool isSnapshot(const string& path) {
+        char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+        ifstream in(path, ios::binary);
+        in.read(magic, sizeof(magic));
+        return in && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+    }
+
+    // Методы с индексами вершин. Алгоритмы работают только с ними, а имена
+    // переводятся в индексы один раз — в методах с именами ниже.
+
+    // Добавляет вершину и возвращает её индекс. Имя может быть любой строкой;
+    // 64-битные идентификаторы передаются десятичной записью (to_string(id)).
+    int addVertex(string_view name, int mark = 0) {
+        int index = size();
+        _marks.push_back(mark);
+        _deleted.push_back(0);
+        _names.add(name); // При повторном имени поиск находит первую живую вершину
+
+        switch (_storage) {
+            case Storage::Bits: bits.add_vertex(); break;
+            case Storage::Csr: csr.add_vertex(); break;
+            default: matrix.add_vertex();
+        }
+        return index;
+    }
+
+    void addEdge(int start, int end, int weight = 1) {
+        check(start, "addEdge");
+        check(end, "addEdge");
+        if (weight == NO_EDGE) {
+            throw std::invalid_argument("Weight NO_EDGE is reserved in addEdge");
+        }
+
+        switch (_storage) {
+            case Storage::Bits:
+                bits.set(start, end);
+                if (weight != 1) bit_weights[edgeKey(start, end)] = weight;
+                else bit_weights.erase(edgeKey(start, end));
+                return;
+            case Storage::Csr:
+                csr.set(start, end, weight);
+                return;
+            default:
+                break;
+        }
+
+        matrix[start][end] = weight;
+    }
+
+    // Вершина только помечается удалённой: её индекс не переиспользуется,
+    // и она пропускается в FIRST/NEXT/VERTEX и print(). Индексы остальных
+    // вершин не меняются до явного вызова compact().
+    void removeVertex(int index) {
+        check(index, "removeVertex");
+
+        _names.erase(index);
+        _deleted[index] = 1;
+        _dead++;
+    }
+
+    void removeEdge(int start, int end) {
+        check(start, "removeEdge");
+        check(end, "removeEdge");
+
+        switch (_storage) {
+            case Storage::Bits:
+                bits.reset(start, end);
+                bit_weights.erase(edgeKey(start, end));
+                return;
+            case Storage::Csr:
+                csr.reset(start, end);
+                return;
+            default:
+                break;
+        }
+
+        matrix[start][end] = NO_EDGE;
+    }
+
+    void setMark(int index, int mark) {
+        check(index, "setMark");
+        _marks[index] = mark;
+    }
+
+    int mark(int index) const {
+        check(index, "mark");
+        return _marks[index];
+    }
+
+    // Меняет вес существующего ребра; вес хранится только вместе с ребром
+    void setWeight(int start, int end, int weight) {
+        check(start, "setWeight");
+        check(end, "setWeight");
+
+        switch (_storage) {
+            case Storage::Bits:
+                if (bits.get(start, end)) {
+                    if (weight != 1) bit_weights[edgeKey(start, end)] = weight;
+                    else bit_weights.erase(edgeKey(start, end));
+                }
+                return;
+            case Storage::Csr:
+                csr.edit(start, end, weight);
+                return;
+            default:
+                break;
+        }
+
+        if (matrix[start][end] != NO_EDGE) matrix[start][end] = weight;
+    }
+
+    bool hasEdge(int start, int end) const {
+        check(start, "hasEdge");
+        check(end, "hasEdge");
+        return cell(start, end);
+    }
+
+    // Вес ребра, 0 — если ребра нет
+    int weight(int start, int end) const {
+        check(start, "weight");
+        check(end, "weight");
+        switch (_storage) {
+            case Storage::Bits: {
+                if (!bits.get(start, end)) return 0;
+                auto it = bit_weights.find(edgeKey(start, end));
+                return it != bit_weights.end() ? it->second : 1;
+            }
+            case Storage::Csr: return csr.weight(start, end);
+            default: return matrix[start][end] == NO_EDGE ? 0 : matrix[start][end];
+        }
+    }
+
+    int first(int v) const {
+        check(v, "first");
+        return nextNeighbor(v, 0);
+    }
+
+    int next(int v, int i) const {
+        check(v, "next");
+        return nextNeighbor(v, max(i + 1, 0));
+    }
+
+    int vertex(int v, int i) const {
+        check(v, "vertex");
+        if (_storage == Storage::Csr && _dead == 0) return csr.nth(v, i);
+
+        for (int w : neighbors(v)) {
+            if (i-- == 0) return w;
+        }
+        return -1;
+    }
+
+    // Резервирует место под count вершин, чтобы ADD_V не перестраивал хранилище
+    void reserve(int count) {
+        _names.reserve(count);
+        _marks.reserve(count);
+        _deleted.reserve(count);
+        switch (_storage) {
+            case Storage::Bits: bits.reserve(count); break;
+            case Storage::Csr: csr.reserve(count); break;
+            default:
+                matrix.reserve(count);
+        }
+    }
+
+    // Убирает удалённые вершины и перенумеровывает оставшиеся за один проход
+    void compact() {
+        if (_dead == 0) return;
+
+        vector<int> remap(size(), -1);
+        int count = 0;
+        for (int i = 0; i < size(); ++i) {
+            if (!_deleted[i]) remap[i] = count++;
+        }
+
+        switch (_storage) {
+            case Storage::Bits: {
+                bits.compact(remap);
+
+                unordered_map<uint64_t, int> updated_weights;
+                for (const auto& [key, w] : bit_weights) {
+                    int s = remap[key >> 32], e = remap[(uint32_t)key];
+                    if (s != -1 && e != -1) updated_weights[edgeKey(s, e)] = w;
+                }
+                bit_weights = std::move(updated_weights);
+                break;
+            }
+            case Storage::Csr:
+                csr.compact(remap);
+                break;
+            default:
+                matrix.compact(remap);
+        }
+
+        for (size_t i = 0; i < remap.size(); ++i) {
+            if (remap[i] != -1) _marks[remap[i]] = _marks[i];
+        }
+        _marks.resize(count);
+        _names.compact(remap);
+
+        _deleted.assign(count, 0);
+        _dead = 0;
+    }
+
+    // Удалена ли вершина с индексом i (до ближайшего compact())
+    bool deleted(int i) const {
+        return _deleted[i];
+    }
+
+    // Набор изменений, который применяется к графу одним проходом в apply().
+    // Новые вершины получают те же индексы, что дал бы ADD_V, поэтому рёбра
+    // к ним можно добавлять в том же наборе. Для одного ребра действует
+    // последнее изменение; вершины удаляются после всех изменений рёбер.
+    // Между созданием набора и apply() граф менять нельзя.
+    class Batch {
+
+    private:
+        friend class Graph;
+
+        const Graph& graph;
+        int base; // graph.size() при создании набора
+        SymbolTable names; // Имена новых вершин
+        vector<int> marks;
+        vector<EdgeRecord> edges; // Вес NO_EDGE — удаление ребра
+        vector<int> removed;
+
+        int index(string_view name) const {
+            int i = graph.indexOfName(name);
+            if (i != -1) return i;
+            i = names.find(name);
+            return i == -1 ? -1 : base + i;
+        }
+
+    public:
+        explicit Batch(const Graph& graph) : graph(graph), base(graph.size()) {}
+
+        int addVertex(string_view name, int mark = 0) {
+            marks.push_back(mark);
+            return base + names.add(name);
+        }
+
+        void addEdge(int start, int end, int weight = 1) {
+            if (weight == NO_EDGE) {
+                throw std::invalid_argument("Weight NO_EDGE is reserved in addEdge");
+            }
+            edges.push_back({start, end, weight});
+        }
+
+        void removeEdge(int start, int end) {
+            edges.push_back({start, end, NO_EDGE});
+        }
+
+        void removeVertex(int index) {
+            removed.push_back(index);
+        }
+
+        void ADD_V(string_view v, int mark = 0) {
+            addVertex(v, mark);
+        }
+
+        void ADD_E(string_view s, string_view e, int weight = 1) {
+            addEdge(index(s), index(e), weight);
+        }
+
+        void DEL_V(string_view v) {
+            int i = index(v);
+            if (i != -1) removeVertex(i);
+        }
+
+        void DEL_E(string_view s, string_view e) {
+            removeEdge(index(s), index(e));
+        }
+
+        void ADD_V(char v, int mark = 0) { ADD_V(string_view(&v, 1), mark); }
+        void ADD_E(char s, char e, int weight = 1) { ADD_E(string_view(&s, 1), string_view(&e, 1), weight); }
+        void DEL_V(char v) { DEL_V(string_view(&v, 1)); }
+        void DEL_E(char s, char e) { DEL_E(string_view(&s, 1), string_view(&e, 1)); }
+
+        // Число накопленных изменений
+        size_t size() const {
+            return marks.size() + edges.size() + removed.size();
+        }
+    };
+
+    Batch batch() const {
+        return Batch(*this);
+    }
+
+    // Применяет набор: вершины добавляются разом, а изменения рёбер CSR
+    // упорядочиваются по началу и сливаются со строками за один проход.
+    // Удалённые вершины только помечаются, как в removeVertex(), и индексы
+    // не сдвигаются до compact(). Индексы проверяются до любых изменений,
+    // так что при ошибке граф не меняется.
+    void apply(const Batch& batch) {
+        if (&batch.graph != this || batch.base != size()) {
+            throw std::logic_error("Batch was made for another graph state");
+        }
+
+        long long total = size() + batch.marks.size();
+        auto valid = [&](long long i) {
+            return i >= 0 && i < total && (i >= size() || !_deleted[i]);
+        };
+        for (const auto& r : batch.edges) {
+            if (!valid(r.s) || !valid(r.e)) throw std::out_of_range("Invalid vertex index in apply");
+        }
+        for (int i : batch.removed) {
+            if (!valid(i)) throw std::out_of_range("Invalid vertex index in apply");
+        }
+
+        reserve(total);
+        for (int k = 0; k < (int)batch.marks.size(); ++k) {
+            addVertex(batch.names.name(k), batch.marks[k]);
+        }
+
+        if (_storage == Storage::Csr) {
+            vector<EdgeRecord> changes = batch.edges;
+            stable_sort(changes.begin(), changes.end(), [](const EdgeRecord& a, const EdgeRecord& b) {
+                return a.s != b.s ? a.s < b.s : a.e < b.e;
+            });
+            // Из повторов одного ребра остаётся последнее
+            size_t kept = 0;
+            for (size_t k = 0; k < changes.size(); ++k) {
+                if (kept > 0 && changes[kept - 1].s == changes[k].s && changes[kept - 1].e == changes[k].e) kept--;
+                changes[kept++] = changes[k];
+            }
+            changes.resize(kept);
+            csr.merge(changes, NO_EDGE);
+        } else {
+            for (const auto& r : batch.edges) {
+                if (r.w == NO_EDGE) removeEdge(r.s, r.e);
+                else addEdge(r.s, r.e, r.w);
+            }
+        }
+
+        for (int i : batch.removed) {
+            if (_deleted[i]) continue;
+            _names.erase(i);
+            _deleted[i] = 1;
+            _dead++;
+        }
+    }
+
+    // Методы с именами вершин. Имя — любая строка; однобуквенные имена
+    // можно передавать как char.
+
+    void ADD_V(string_view v, int mark = 0) {
+        addVertex(v, mark);
+    }
+
+    void ADD_E(string_view s, string_view e, int weight = 1) {
+        addEdge(indexOfName(s), indexOfName(e), weight);
+    }
+
+    // Вершины адресуются именами, поэтому здесь граф можно перенумеровать:
+    // когда удалённых больше половины, вызывается compact()
+    void DEL_V(string_view v) {
+        int index = indexOfName(v);
+        if (index == -1) return;
+        removeVertex(index);
+        if (_dead * 2 > size()) compact();
+    }
+
+    void DEL_E(string_view s, string_view e) {
+        removeEdge(indexOfName(s), indexOfName(e));
+    }
+
+    void EDIT_V(string_view v, int mark){
+        setMark(indexOfName(v), mark);
+    }
+
+    void EDIT_E(string_view s, string_view e, int weight) {
+        setWeight(indexOfName(s), indexOfName(e), weight);
+    }
+
+    int FIRST(string_view v) const {
+        return first(indexOfName(v));
+    }
+
+    int NEXT(string_view v, int i) const {
+        return next(indexOfName(v), i);
+    }
+
+    int VERTEX(string_view v, int i) const {
+        return vertex(indexOfName(v), i);
+    }
+
+    void ADD_V(char v, int mark = 0) { ADD_V(string_view(&v, 1), mark); }
+    void ADD_E(char s, char e, int weight = 1) { ADD_E(string_view(&s, 1), string_view(&e, 1), weight); }
+    void DEL_V(char v) { DEL_V(string_view(&v, 1)); }
+    void DEL_E(char s, char e) { DEL_E(string_view(&s, 1), string_view(&e, 1)); }
+    void EDIT_V(char v, int mark) { EDIT_V(string_view(&v, 1), mark); }
+    void EDIT_E(char s, char e, int weight) { EDIT_E(string_view(&s, 1), string_view(&e, 1), weight); }
+    int FIRST(char v) const { return FIRST(string_view(&v, 1)); }
+    int NEXT(char v, int i) const { return NEXT(string_view(&v, 1), i); }
+    int VERTEX(char v, int i) const { return VERTEX(string_view(&v, 1), i); }
+
+    void print(ostream& stream = cout)  {
+        Writer out(stream);
+        out << "Vertices:\n";
+        for (int i = 0; i < size(); ++i) {
+            if (_deleted[i]) continue;
+            out << "Vertex " << i << " (name: " << _names.name(i) << " mark: " << _marks[i] << ")\n";
+        }
+
+        // Вывод матрицы смежности
+        out << "\nAdjacency Matrix:\n";
+        for (int i = 0; i < size(); ++i) {
+            if (_deleted[i]) continue;
+            for (int j = 0; j < size(); ++j) {
+                if (!_deleted[j]) out << cell(i, j) << ' ';
+            }
+            out << '\n';
+        }
+
+        // Вывод матрицы весов
+        out << "\nWeight Matrix:\n";
+        for (int i = 0; i < size(); ++i) {
+            if (_deleted[i]) continue;
+            for (int j = 0; j < size(); ++j) {
+                if (!_deleted[j]) out << weight(i, j) << ' ';
+            }
+            out << '\n';
+        }
+    }
+
+    // Число индексов вершин, включая удалённые до compact()
+    int size() const {
+        switch (_storage) {
+            case Storage::Bits: return bits.size();
+            case Storage::Csr: return csr.size();
+            default: return matrix.size();
+        }
+    }
+};
+
+// Порядок стартовых вершин для поиска Джонсона. Из s поиск идёт только по
+// компоненте сильной связности s в подграфе вершин >= s. Такие компоненты
+// вложены друг в друга: без своей минимальной вершины компонента распадается
+// на меньшие. Поэтому вершины можно расставить так, что каждая компонента
+// занимает отрезок порядка, начинающийся с её минимальной вершины.
+struct CycleOrder {
+    vector<int> pos;  // Место вершины в порядке
+    vector<int> span; // Размер компоненты s в подграфе вершин >= s; 0 — через s там нет циклов
+
+    // Лежит ли w в компоненте s
+    bool inside(int s, int w) const {
+        return (unsigned)(pos[w] - pos[s]) < (unsigned)span[s];
+    }
+};
+
+// Строит CycleOrder. Компоненты всего графа находятся алгоритмом Тарьяна,
+// затем из каждой нетривиальной компоненты убирается минимальная вершина,
+// и остаток снова делится на компоненты. Разбиение компоненты стоит не
+// больше поиска из её минимальной вершины, а тривиальная компонента — O(1).
+inline CycleOrder cycleOrder(const Graph& graph) {
+    int n = graph.size();
+    vector<int> order; // Удалённые вершины — в конце, вне компонент
+    for (int v = 0; v < n; ++v) {
+        if (!graph.deleted(v)) order.push_back(v);
+    }
+    int alive = order.size();
+    for (int v = 0; v < n; ++v) {
+        if (graph.deleted(v)) order.push_back(v);
+    }
+
+    vector<int> index(n, -1), low(n, 0), owner(n, -1);
+    vector<bool> onStack(n, false);
+    vector<int> stack, sorted;
+    vector<pair<int, Graph::NeighborIterator>> calls; // Вершина и её следующий сосед
+    vector<pair<int, int>> ranges; // Отрезки order, ещё не разобранные
+    int splits = 0;
+
+    // Делит order[lo, hi) на компоненты сильной связности по рёбрам внутри
+    // отрезка (алгоритм Тарьяна без рекурсии), ставит их подряд и добавляет
+    // их отрезки в ranges
+    auto split = [&](int lo, int hi) {
+        int id = splits++;
+        for (int i = lo; i < hi; ++i) {
+            owner[order[i]] = id;
+            index[order[i]] = -1;
+        }
+        sorted.clear();
+        int counter = 0;
+
+        for (int i = lo; i < hi; ++i) {
+            int root = order[i];
+            if (index[root] != -1) continue;
+
+            index[root] = low[root] = counter++;
+            stack.push_back(root);
+            onStack[root] = true;
+            calls.push_back({root, graph.neighbors(root).begin()});
+
+            while (!calls.empty()) {
+                auto& [v, next] = calls.back();
+                if (!next.done()) {
+                    int w = *next;
+                    ++next;
+                    if (owner[w] != id) continue;
+                    if (index[w] == -1) {
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        onStack[w] = true;
+                        calls.push_back({w, graph.neighbors(w).begin()});
+                    } else if (onStack[w]) {
+                        low[v] = min(low[v], index[w]);
+                    }
+                    continue;
+                }
+
+                int u = v;
+                calls.pop_back();
+                if (!calls.empty()) {
+                    int parent = calls.back().first;
+                    low[parent] = min(low[parent], low[u]);
+                }
+                if (low[u] != index[u]) continue;
+
+                // u — корень компоненты: снимаем её со стека
+                int first = sorted.size(), x;
+                do {
+                    x = stack.back();
+                    stack.pop_back();
+                    onStack[x] = false;
+                    sorted.push_back(x);
+                } while (x != u);
+                ranges.push_back({lo + first, lo + (int)sorted.size()});
+            }
+        }
+        copy(sorted.begin(), sorted.end(), order.begin() + lo);
+    };
+
+    CycleOrder result;
+    result.span.assign(n, 0);
+    split(0, alive);
+    while (!ranges.empty()) {
+        auto [lo, hi] = ranges.back();
+        ranges.pop_back();
+
+        int least = lo;
+        for (int i = lo + 1; i < hi; ++i) {
+            if (order[i] < order[least]) least = i;
+        }
+        swap(order[lo], order[least]);
+        int s = order[lo];
+        // Одиночная вершина лежит на цикле, только если у неё есть петля
+        if (hi - lo > 1 || graph.nextNeighbor(s, s) == s) result.span[s] = hi - lo;
+        if (hi - lo > 1) split(lo + 1, hi);
+    }
+
+    result.pos.assign(n, 0);
+    for (int i = 0; i < n; ++i) result.pos[order[i]] = i;
+    return result;
+}
+
+// Обратные рёбра графа в CSR: строка v содержит вершины u с ребром u -> v.
+// Строится подсчётом за O(V + E).
+inline CsrStore reverseEdges(const Graph& graph) {
+    int n = graph.size();
+    vector<int> offsets(n + 1, 0);
+    for (int u = 0; u < n; ++u) {
+        if (graph.deleted(u)) continue;
+        for (int v : graph.neighbors(u)) offsets[v + 1]++;
+    }
+    for (int v = 0; v < n; ++v) offsets[v + 1] += offsets[v];
+
+    vector<int> sources(offsets[n]);
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int u = 0; u < n; ++u) {
+        if (graph.deleted(u)) continue;
+        for (int v : graph.neighbors(u)) sources[fill[v]++] = u;
+    }
+
+    CsrStore reverse;
+    reverse.reserve(n);
+    for (int v = 0; v < n; ++v) {
+        for (int p = offsets[v]; p < offsets[v + 1]; ++p) reverse.push(sources[p], 1);
+        reverse.close_row();
+    }
+    return reverse;
+}
+
+// Задача поиска циклов: стартовая вершина s и уже пройденный путь prefix
+// (начинается с s, поиск продолжается из последней вершины)
+struct CycleTask {
+    int s;
+    vector<int> prefix;
+};
+
+// Планировщик с очередью задач у каждого потока. Поток берёт задачи
+// с конца своей очереди, а простаивающие потоки крадут их с начала чужих.
+// Поток, которому нечего украсть, спит на wake до новой задачи или до конца работы.
+class CycleScheduler {
+
+private:
+    struct Queue {
+        mutex lock;
+        deque<CycleTask> tasks;
+    };
+
+    vector<Queue> queues;
+    atomic<long long> pending{0}; // Поставлено, но ещё не выполнено
+    atomic<long long> queued{0};  // Лежит в очередях
+    atomic<int> idle{0};
+    mutex sleep;
+    condition_variable wake;
+
+    bool steal(int worker, CycleTask& task) {
+        int n = queues.size();
+        for (int k = 1; k < n; ++k) {
+            Queue& q = queues[(worker + k) % n];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Будит спящие потоки. Захват sleep не даёт уведомлению проскочить между
+    // проверкой условия в wait() и засыпанием.
+    void notify(bool all) {
+        { lock_guard<mutex> guard(sleep); }
+        if (all) wake.notify_all();
+        else wake.notify_one();
+    }
+
+public:
+    explicit CycleScheduler(int threads) : queues(threads) {}
+
+    void push(int worker, CycleTask task) {
+        pending++;
+        {
+            lock_guard<mutex> guard(queues[worker].lock);
+            queues[worker].tasks.push_back(std::move(task));
+        }
+        queued++;
+        if (idle > 0) notify(false);
+    }
+
+    bool pop(int worker, CycleTask& task) {
+        {
+            Queue& q = queues[worker];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        return steal(worker, task);
+    }
+
+    // Ждёт задачу; возвращает false, когда вся работа выполнена
+    bool wait(int worker, CycleTask& task) {
+        while (!pop(worker, task)) {
+            unique_lock<mutex> guard(sleep);
+            idle++;
+            wake.wait(guard, [&] { return queued > 0 || pending == 0; });
+            idle--;
+            if (pending == 0) return false;
+        }
+        return true;
+    }
+
+    void done() {
+        if (--pending == 0) notify(true);
+    }
+
+    // Стоит ли отдать ветку поддерева: кто-то простаивает, а красть ему нечего.
+    // Отданная задача сама заполняет очереди, так что ветки уходят по одной.
+    bool hungry() const {
+        return idle.load(memory_order_relaxed) > 0 && queued.load(memory_order_relaxed) == 0;
+    }
+};
+
+// Получает очередной найденный цикл: вершины пути и в конце снова стартовая.
+// Вектор переиспользуется поиском, его нужно скопировать, если цикл нужен
+// после возврата. Если вернуть false, поиск остановится.
+using CycleVisitor = function<bool(const vector<int>& cycle)>;
+
+// Число циклов без их сохранения
+struct CycleCount {
+    unsigned long long total = 0;
+    bool byLength = false; // Вести ли histogram
+    vector<unsigned long long> histogram; // histogram[k] — число циклов из k рёбер
+
+    void add(int length) {
+        total++;
+        if (!byLength) return;
+        if (histogram.size() <= length) histogram.resize(length + 1, 0);
+        histogram[length]++;
+    }
+
+    void merge(const CycleCount& other) {
+        total += other.total;
+        if (histogram.size() < other.histogram.size()) histogram.resize(other.histogram.size(), 0);
+        for (int k = 0; k < other.histogram.size(); ++k) histogram[k] += other.histogram[k];
+    }
+};
+
+// Поиск элементарных циклов алгоритмом Джонсона.
+// Стартовые вершины перебираются по возрастанию индекса, и из вершины s
+// рассматриваются только вершины с индексом >= s, поэтому каждый цикл
+// находится ровно один раз (начиная с его минимальной вершины).
+// Множество blocked и списки B не дают повторно заходить в поддеревья,
+// из которых нельзя вернуться в s.
+// Поиск идёт без рекурсии: кадры путей лежат в заранее выделенном стеке,
+// поэтому длина пути ограничена только числом вершин.
+// С ограничением длины maxLength путь обрезается на глубине maxLength, а в
+// вершину w не заходим, если из неё по кратчайшему пути (dist[w], обратный
+// BFS от s) не вернуться в s в оставшееся число рёбер. Блокировка Джонсона
+// для коротких циклов неверна, поэтому тогда blocked отмечает только путь.
+// Цикл с минимальной вершиной s лежит в компоненте сильной связности s
+// в подграфе вершин >= s (CycleOrder), поэтому поиск из s не выходит за неё,
+// а s, через которую там нет циклов, не стартует вовсе. Без ограничения
+// длины каждый старт находит хотя бы один цикл, и время O((V + E)(C + 1)).
+class Johnson {
+
+private:
+    // Кадр стека: вершина пути, её следующий непросмотренный сосед и
+    // найден ли из неё цикл
+    struct Frame {
+        int v;
+        Graph::NeighborIterator next;
+        bool found;
+    };
+
+    const Graph& graph;
+    const CycleOrder& order; // Результат cycleOrder()
+
+    // Найденный цикл либо передаётся в visit, либо только учитывается в counter
+    const CycleVisitor* visit = nullptr;
+    CycleCount* counter = nullptr;
+
+    // Флаг остановки, общий для всех потоков одного поиска
+    atomic<bool>& stop;
+
+    // Ограничение длины цикла (0 — без ограничения)
+    int maxLength = 0;
+    const CsrStore* reverse = nullptr; // Результат reverseEdges()
+    vector<int> dist;    // Расстояние до s, INT_MAX — не вернуться за maxLength
+    vector<int> reached; // Вершины с конечным dist
+
+    // Если задан планировщик, непройденные ветки отдаются простаивающим потокам
+    CycleScheduler* scheduler = nullptr;
+    int worker = 0;
+
+    vector<Frame> frames;
+    vector<int> path;
+    vector<bool> blocked;
+    vector<vector<int>> B;
+    vector<int> pending; // Стек для unblock()
+    vector<int> touched; // Вершины, чьи blocked или B менялись при текущем s
+    vector<bool> dirty;
+    int s = 0;
+
+    void touch(int v) {
+        if (!dirty[v]) {
+            dirty[v] = true;
+            touched.push_back(v);
+        }
+    }
+
+    void block(int v) {
+        blocked[v] = true;
+        touch(v);
+    }
+
+    void unblock(int u) {
+        blocked[u] = false;
+        pending.push_back(u);
+        while (!pending.empty()) {
+            int x = pending.back();
+            pending.pop_back();
+            for (int w : B[x]) {
+                if (blocked[w]) {
+                    blocked[w] = false;
+                    pending.push_back(w);
+                }
+            }
+            B[x].clear();
+        }
+    }
+
+    void enter(int v) {
+        path.push_back(v);
+        block(v);
+        // Вершины меньше s уже обработаны
+        frames.push_back({v, graph.neighbors(v, s).begin(), false});
+    }
+
+    void circuit(int start) {
+        size_t base = path.size();
+        enter(start);
+
+        while (!frames.empty()) {
+            if (stop.load(memory_order_relaxed)) {
+                frames.clear();
+                path.resize(base);
+                return;
+            }
+
+            Frame& f = frames.back();
+            if (!f.next.done()) {
+                int w = *f.next;
+                ++f.next;
+                if (!order.inside(s, w)) continue;
+                if (w == s) { // Найден цикл
+                    if (counter) {
+                        counter->add(path.size());
+                    } else {
+                        path.push_back(s);
+                        if (!(*visit)(path)) stop = true;
+                        path.pop_back();
+                    }
+                    f.found = true;
+                } else if (!blocked[w]) {
+                    // Из w уже не успеть вернуться в s
+                    if (maxLength > 0 && (dist[w] == INT_MAX || path.size() + dist[w] > maxLength)) continue;
+
+                    if (scheduler && scheduler->hungry()) {
+                        // Ветку через w пройдёт другой поток. Считаем, что она нашла
+                        // цикл: лишняя разблокировка безопасна, а лишняя блокировка нет.
+                        path.push_back(w);
+                        scheduler->push(worker, {s, path});
+                        path.pop_back();
+                        f.found = true;
+                    } else {
+                        enter(w);
+                    }
+                }
+                continue;
+            }
+
+            // Все соседи вершины просмотрены
+            int v = f.v;
+            bool found = f.found;
+            if (maxLength > 0) {
+                blocked[v] = false;
+            } else if (found) {
+                unblock(v);
+            } else {
+                // Из v пока нельзя вернуться в s: разблокируем её только вместе с соседями
+                for (int u : graph.neighbors(v, s)) {
+                    if (!order.inside(s, u)) continue;
+                    if (find(B[u].begin(), B[u].end(), v) == B[u].end()) {
+                        B[u].push_back(v);
+                        touch(u);
+                    }
+                }
+            }
+
+            frames.pop_back();
+            path.pop_back();
+            if (found && !frames.empty()) frames.back().found = true;
+        }
+    }
+
+    // Сбрасывает состояние, оставшееся от предыдущей стартовой вершины
+    void reset() {
+        int n = graph.size();
+        if (blocked.size() != n) {
+            blocked.assign(n, false);
+            dirty.assign(n, false);
+            B.assign(n, {});
+            touched.clear();
+            frames.reserve(n);
+            path.reserve(n + 1);
+        }
+        for (int v : touched) {
+            blocked[v] = false;
+            dirty[v] = false;
+            B[v].clear();
+        }
+        touched.clear();
+
+        if (maxLength > 0) distances();
+    }
+
+    // Обратный BFS от s по вершинам >= s из компоненты s, не глубже maxLength - 1
+    void distances() {
+        if (dist.size() != graph.size()) dist.assign(graph.size(), INT_MAX);
+        for (int v : reached) dist[v] = INT_MAX;
+        reached.clear();
+
+        dist[s] = 0;
+        reached.push_back(s);
+        for (int head = 0; head < reached.size(); ++head) {
+            int v = reached[head];
+            if (dist[v] + 1 >= maxLength) break; // BFS идёт по слоям
+            for (int i = 0, u; (u = reverse->nth(v, i)) != -1; ++i) {
+                if (!order.inside(s, u) || dist[u] != INT_MAX) continue;
+                dist[u] = dist[v] + 1;
+                reached.push_back(u);
+            }
+        }
+    }
+
+public:
+    Johnson(const Graph& graph, const CycleOrder& order, atomic<bool>& stop)
+        : graph(graph), order(order), stop(stop) {}
+
+    void setVisitor(const CycleVisitor& v) {
+        visit = &v;
+    }
+
+    void setCounter(CycleCount& c) {
+        counter = &c;
+    }
+
+    // Работа в составе пула потоков с общим планировщиком
+    void setScheduler(CycleScheduler& sched, int id) {
+        scheduler = &sched;
+        worker = id;
+    }
+
+    // Искать только циклы не длиннее length рёбер
+    void setMaxLength(int length, const CsrStore& reverseEdges) {
+        maxLength = length;
+        reverse = &reverseEdges;
+    }
+
+    void run() {
+        for (s = 0; s < graph.size() && !stop; ++s) {
+            if (order.span[s] == 0) continue;
+            reset();
+            circuit(s);
+        }
+    }
+
+    // Продолжает поиск циклов с минимальной вершиной task.s по пути task.prefix
+    void run(const CycleTask& task) {
+        if (stop) return;
+        s = task.s;
+        reset();
+        path.assign(task.prefix.begin(), task.prefix.end() - 1);
+        for (int v : path) block(v);
+        circuit(task.prefix.back());
+        path.clear();
+    }
+};
+
+// Запускает поиск на threads потоках (при threads <= 1 — в текущем).
+// Каждая стартовая вершина — отдельная задача, а занятые потоки по запросу
+// отдают непройденные ветки своих поддеревьев. setup(johnson, t) настраивает,
+// куда поток t отдаёт циклы. maxLength > 0 ограничивает длину циклов.
+inline void runCycleSearch(const Graph& graph, int threads, int maxLength,
+                           const function<void(Johnson&, int)>& setup, atomic<bool>& stop) {
+    CycleOrder order = cycleOrder(graph);
+    CsrStore reverse;
+    if (maxLength > 0) reverse = reverseEdges(graph);
+
+    if (threads <= 1) {
+        Johnson johnson(graph, order, stop);
+        if (maxLength > 0) johnson.setMaxLength(maxLength, reverse);
+        setup(johnson, 0);
+        johnson.run();
+        return;
+    }
+
+    CycleScheduler scheduler(threads);
+    for (int s = 0; s < graph.size(); ++s) {
+        if (order.span[s] > 0) scheduler.push(s % threads, {s, {s}});
+    }
+
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            Johnson johnson(graph, order, stop);
+            johnson.setScheduler(scheduler, t);
+            if (maxLength > 0) johnson.setMaxLength(maxLength, reverse);
+            setup(johnson, t);
+            CycleTask task;
+            while (scheduler.wait(t, task)) {
+                johnson.run(task);
+                scheduler.done();
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+// Потоковый поиск: каждый цикл передаётся в visit сразу, как только найден,
+// и нигде не накапливается. При threads > 1 вызовы visit идут по очереди,
+// но порядок циклов не определён.
+inline void forEachCycle(const Graph& graph, const CycleVisitor& visit, int threads = 1, int maxLength = 0) {
+    atomic<bool> stop{false};
+    if (threads <= 1) {
+        runCycleSearch(graph, 1, maxLength, [&](Johnson& johnson, int) {
+            johnson.setVisitor(visit);
+        }, stop);
+        return;
+    }
+
+    mutex lock;
+    CycleVisitor serialized = [&](const vector<int>& cycle) {
+        lock_guard<mutex> guard(lock);
+        if (!stop && !visit(cycle)) stop = true;
+        return !stop;
+    };
+    runCycleSearch(graph, threads, maxLength, [&](Johnson& johnson, int) {
+        johnson.setVisitor(serialized);
+    }, stop);
+}
+
+// Все циклы графа. У каждого потока свой буфер; после слияния циклы
+// упорядочиваются так же, как при последовательном поиске.
+inline vector<vector<int>> findCycles(const Graph& graph, int threads = 1, int maxLength = 0) {
+    threads = max(threads, 1);
+    vector<vector<vector<int>>> buffers(threads);
+    vector<CycleVisitor> visitors;
+    for (int t = 0; t < threads; ++t) {
+        visitors.push_back([&buffer = buffers[t]](const vector<int>& cycle) {
+            buffer.push_back(cycle);
+            return true;
+        });
+    }
+    atomic<bool> stop{false};
+    runCycleSearch(graph, threads, maxLength, [&](Johnson& johnson, int t) {
+        johnson.setVisitor(visitors[t]);
+    }, stop);
+
+    if (threads == 1) return std::move(buffers[0]);
+
+    vector<vector<int>> cycles;
+    for (auto& buffer : buffers) {
+        move(buffer.begin(), buffer.end(), back_inserter(cycles));
+    }
+    sort(cycles.begin(), cycles.end());
+    return cycles;
+}
+
+// Подсчёт циклов без построения путей; byLength включает гистограмму по длине
+inline CycleCount countCycles(const Graph& graph, int threads = 1, bool byLength = false, int maxLength = 0) {
+    threads = max(threads, 1);
+    CycleCount result;
+    result.byLength = byLength;
+
+    vector<CycleCount> counters(threads, result);
+    atomic<bool> stop{false};
+    runCycleSearch(graph, threads, maxLength, [&](Johnson& johnson, int t) {
+        johnson.setCounter(counters[t]);
+    }, stop);
+
+    for (const auto& counter : counters) result.merge(counter);
+    return result;
+}
+
+// Печатает только число циклов (и, если нужно, сколько циклов каждой длины)
+inline void taskCount(Graph& graph, int threads = 1, bool byLength = false, int maxLength = 0) {
+    CycleCount count = countCycles(graph, threads, byLength, maxLength);
+
+    cout << "Количество циклов: " << count.total << "\n";
+    for (int k = 1; k < count.histogram.size(); ++k) {
+        if (count.histogram[k] != 0) cout << "Длина " << k << ": " << count.histogram[k] << "\n";
+    }
+}
+
+// Циклы выводятся по мере нахождения, поэтому число циклов печатается в конце.
+// Каждый цикл выводится один раз, начиная с наименьшего индекса: так его
+// находит поиск Джонсона, и поворачивать или убирать повторы не нужно.
+// maxLength > 0 оставляет только циклы не длиннее maxLength рёбер.
+// С asyncOutput = true вывод пишет отдельный поток, и поиск не ждёт stdout.
+inline void task(Graph& graph, int threads = 1, int maxLength = 0, bool asyncOutput = false) {
+    long long count = 0;
+
+    Writer out(cout, asyncOutput);
+    out << "Варианты обхода, образующие циклы:\n";
+    forEachCycle(graph, [&](const vector<int>& cycle) {
+        for (int v : cycle) {
+            out << v << ' ';
+        }
+        out << '\n';
+        count++;
+        return true;
+    }, threads, maxLength);
+
+    out << "Количество циклов: " << count << '\n';
+}
+
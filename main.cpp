@@ -1,210 +1,66 @@
-#include <iostream>
-#include <vector>
-#include <map>
-#include <algorithm>
+#include "graph.h"
 
-
-using namespace std;
-
-struct Vertex {
-    char name;
-    int mark;
-};
-
-class Graph {
-
-private:
-    vector<vector<int>> matrix;
-    vector<vector<int>> matrix_weight;
-
-    map<int, Vertex> _vertices;
-
-public:
-    Graph() = default;
-
-    int indexOfName(char c) {
-        for (const auto& [key, value] : _vertices) {
-            if (value.name == c) {
-                return key;
-            }
-        }
-        return -1;
-    }
-
-    char nameOfIndex(int i) {
-        return _vertices[i].name;
-    }
-
-    void ADD_V(char v, int mark = 0) {
-        _vertices[_vertices.size()] = {v, mark};
-
-        matrix.resize(_vertices.size());
-        for (auto& row : matrix) {
-            row.resize(_vertices.size(), 0);
-        }
-
-        matrix_weight.resize(_vertices.size());
-        for (auto& row : matrix_weight) {
-            row.resize(_vertices.size(), 0);
-        }
-    }
-
-    void ADD_E(char s, char e, int weight = 1) {
-        int start = indexOfName(s);
-        int end = indexOfName(e);
-
-        if (start >= matrix.size() || end >= matrix.size()) {
-            throw std::out_of_range("Invalid vertex index in ADD_E");
-        }
-
-        matrix[start][end] = 1;
-        matrix_weight[start][end] = weight;
-    }
-
-    void DEL_V(char v) {
-        int index = indexOfName(v);
-        if (index == -1) return;
-
-        _vertices.erase(index);
-
-        matrix.erase(matrix.begin() + index);
-        for (auto& row : matrix) {
-            row.erase(row.begin() + index);
-        }
-
-        matrix_weight.erase(matrix_weight.begin() + index);
-        for (auto& row : matrix_weight) {
-            row.erase(row.begin() + index);
-        }
-
-        std::map<int, Vertex> updated_vertices;
-
-        for (const auto& [key, value] : _vertices) {
-            int new_key = key > index ? key - 1 : key;
-            updated_vertices[new_key] = value;
-        }
-        _vertices = std::move(updated_vertices);
-    }
-
-
-    void DEL_E(char s, char e) {
-        int start = indexOfName(s);
-        int end = indexOfName(e);
-
-        matrix[start][end] = 0;
-        matrix_weight[start][end] = 0;
-    }
-
-    void EDIT_V(char v, int mark){
-        _vertices[indexOfName(v)] = {v, mark};
-    }
-
-    void EDIT_E(char s, char e, int weight) {
-        int start = indexOfName(s);
-        int end = indexOfName(e);
-        matrix_weight[start][end] = weight;
-    }
-
-    int FIRST(char v) {
-        for (int i = 0; i < matrix[indexOfName(v)].size(); ++i) {
-            if (matrix[indexOfName(v)][i] == 1) {
-                return i;
-            }
-        }
-        return -1;
-    }
-
-    int NEXT(char v, int i) {
-        for (int j = i + 1; j < matrix[indexOfName(v)].size(); ++j) {
-            if (matrix[indexOfName(v)][j] == 1) {
-                return j;
-            }
-        }
-        return -1;
-    }
-
-    int VERTEX(char v, int i) {
-        for (int j = 0; j < matrix[indexOfName(v)].size(); ++j) {
-            if (matrix[indexOfName(v)][j] == 1 && i == 0) {
-                return j;
-            }
-            else if (matrix[indexOfName(v)][j] == 1) i--;
-        }
-
-        return -1;
-    }
-    void print()  {
-        std::cout << "Vertices:\n";
-        for (const auto& [vertex, vertie] : _vertices) {
-            std::cout << "Vertex " << vertex << " (name: " << vertie.name << " mark: " << vertie.mark << ")\n";
-        }
-
-        // Вывод матрицы смежности
-        std::cout << "\nAdjacency Matrix:\n";
-        for (const auto& row : matrix) {
-            for (int cell : row) {
-                std::cout << cell << " ";
-            }
-            std::cout << "\n";
-        }
-
-        // Вывод матрицы весов
-        std::cout << "\nWeight Matrix:\n";
-        for (const auto& row : matrix_weight) {
-            for (int weight : row) {
-                std::cout << weight << " ";
-            }
-            std::cout << "\n";
+// Точка входа в программу
+// Использование: Algosi_copy [--threads=N] [--max-length=K] [--count | --histogram] [--async-output]
+//                   [--storage=matrix|bits|csr] [--format=edges|dimacs|mtx] [--save=снимок] [файл]
+//   --max-length только циклы не длиннее K рёбер
+//   --count      только число циклов, без вывода графа и самих циклов
+//   --histogram  то же, плюс число циклов каждой длины
+//   --async-output  циклы выводит отдельный поток
+//   --storage    способ хранения графа из файла
+//   --format     файл — список рёбер, DIMACS или Matrix Market, а не matrix.txt
+//   --save       сохранить граф в двоичный снимок
+// Без --format файл — matrix.txt или снимок, записанный через --save.
+int main(int argc, char* argv[]) {
+    int threads = 1, maxLength = 0;
+    bool countOnly = false, byLength = false, asyncOutput = false;
+    Storage storage = Storage::Matrix;
+    string path, savePath, format;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--threads=", 0) == 0) {
+            threads = stoi(arg.substr(10));
+            if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+        } else if (arg.rfind("--max-length=", 0) == 0) {
+            maxLength = stoi(arg.substr(13));
+        } else if (arg == "--count") {
+            countOnly = true;
+        } else if (arg == "--histogram") {
+            countOnly = byLength = true;
+        } else if (arg == "--async-output") {
+            asyncOutput = true;
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            string name = arg.substr(10);
+            if (name == "bits") storage = Storage::Bits;
+            else if (name == "csr") storage = Storage::Csr;
+            else if (name != "matrix") throw std::invalid_argument("Unknown storage " + name);
+        } else if (arg.rfind("--format=", 0) == 0) {
+            format = arg.substr(9);
+        } else if (arg.rfind("--save=", 0) == 0) {
+            savePath = arg.substr(7);
+        } else {
+            path = arg;
         }
     }
-    int size() const {
-        return matrix.size();
-    }
-};
 
-void dfs(char v, vector<int>& path, Graph& graph, vector<vector<int>>& cycles) {
-    // Получаем индекс первой смежной вершины
-    int w = graph.FIRST(v);
-    if (w == -1) return; // Если нет смежных вершин, возвращаемся
-
-    while (w != -1) {
-        if (w == path[0]) { // Найден цикл
-            path.push_back(w);
-            cycles.push_back(path);
-            path.pop_back(); // Убираем последний элемент для продолжения поиска
-        } else if (find(path.begin(), path.end(), w) == path.end()) { // Если вершина еще не в пути
-            path.push_back(w);
-            dfs(graph.nameOfIndex(w), path, graph, cycles);
-            path.pop_back(); // Убираем вершину после рекурсивного вызова
+    if (!path.empty()) { // Граф из снимка, списка рёбер или файла формата matrix.txt
+        Graph g;
+        if (format == "edges") g = Graph::importEdges(path, EdgeFormat::EdgeList, storage, threads);
+        else if (format == "dimacs") g = Graph::importEdges(path, EdgeFormat::Dimacs, storage, threads);
+        else if (format == "mtx") g = Graph::importEdges(path, EdgeFormat::MatrixMarket, storage, threads);
+        else if (!format.empty()) throw std::invalid_argument("Unknown format " + format);
+        else if (Graph::isSnapshot(path)) g = Graph::loadSnapshot(path);
+        else g = Graph::load(path, storage);
+        if (!savePath.empty()) g.saveSnapshot(savePath);
+        if (countOnly) {
+            taskCount(g, threads, byLength, maxLength);
+            return 0;
         }
-
-        // Переходим к следующей смежной вершине
-        w = graph.NEXT(v, w);
+        g.print();
+        task(g, threads, maxLength, asyncOutput);
+        return 0;
     }
-}
-
-void task(Graph& graph) {
-    vector<vector<int>> cycles;
 
-    for (int i = 0; i < graph.size(); ++i) { // Перебор всех вершин
-        vector<int> path = {i}; // Стартовый путь
-        dfs(graph.nameOfIndex(i), path, graph, cycles); // Запуск DFS для вершины i
-    }
-
-    // Вывод результатов
-    cout << "Количество циклов: " << cycles.size() << "\n";
-    cout << "Варианты обхода, образующие циклы:\n";
-    for (const auto& cycle : cycles) {
-        for (int v : cycle) {
-            cout << v << " ";
-        }
-        cout << "\n";
-    }
-}
-
-
-// Точка входа в программу
-int main() {
     Graph g;
 
     /*g.ADD_V('a',0);
@@ -232,15 +88,16 @@ int main() {
     g.ADD_V('f',0);
     g.ADD_V('j',0);
 
-    g.print();
+    if (!countOnly) g.print();
     g.DEL_V('k');
     g.DEL_V('a');
     g.DEL_V('b');
+    g.compact(); // Перенумеровать вершины после удалений
 
     g.ADD_V('a',0);
     g.ADD_V('b',0);
 
-    g.print();
+    if (!countOnly) g.print();
 
     g.ADD_E('a','b');
     g.ADD_E('a','d');
@@ -254,9 +111,11 @@ int main() {
     g.ADD_E('f','a');
 
 
-    g.print();
+    if (!countOnly) g.print();
+    if (!savePath.empty()) g.saveSnapshot(savePath);
 
-    task(g);
+    if (countOnly) taskCount(g, threads, byLength, maxLength);
+    else task(g, threads, maxLength, asyncOutput);
 
     return 0;
 }